@@ -26,9 +26,22 @@
 //     array_iter (x, &a) if (x == 1) array_remove(&a, ARRAY_IDX--);
 //     array_iter (x, &a) printf("[%lu] = %lu\n", ARRAY_IDX, x);
 //
+// The SmallArray<T, N> has the same layout as Array<T> plus an
+// inline buffer for N elements, and it works with all array_*
+// functions. It only calls the allocator once it grows beyond
+// N elements. Since the data pointer can point into the struct
+// itself, a SmallArray must be initialized in place with
+// array_init() and must not be copied or moved afterwards:
+//
+//     SmallArray<U64, 8> a;
+//     array_init(&a, mem);
+//     array_push(&a, 42lu); // No allocation.
+//
 // =============================================================================
 #include <cstring>
 #include "base/mem.h"
+#include "base/sort.h"
+#include "base/simd.h"
 
 template <typename T>
 struct Slice {
@@ -44,6 +57,15 @@ struct Array {
     Mem *mem;
 };
 
+template <typename T, U64 N>
+struct SmallArray {
+    T *data;
+    U64 count;
+    U64 capacity;
+    Mem *mem;
+    T inline_buf[N];
+};
+
 #define Elem(T)  Type(static_cast<T*>(0)->data[0])
 #define Elemv(A) Type((A)->data[0])
 
@@ -76,6 +98,8 @@ template <typename T> U64 array_byte_size (T *a) { return array_elem_size(a) * a
 
 template <typename T>
 Void array_maybe_decrease_capacity (T *a) {
+    if constexpr (requires { a->inline_buf; }) if (a->data == a->inline_buf) return;
+
     if ((a->capacity > 4) && (a->count < (safe_mul(a->capacity, 25lu) / 100))) {
         U64 new_cap = 2 * a->count;
         a->data     = mem_shrink(a->mem, Elem(T), .size=(array_elem_size(a) * new_cap), .old_ptr=a->data, .old_size=(array_elem_size(a) * a->capacity));
@@ -96,6 +120,16 @@ template <typename T>
 Void array_increase_capacity (T *a, U64 n) {
     assert_dbg(n);
     U64 new_cap = safe_add(a->capacity, n);
+
+    if constexpr (requires { a->inline_buf; }) {
+        if (a->data == a->inline_buf) {
+            a->data     = mem_alloc(a->mem, Elem(T), .size=(array_elem_size(a) * new_cap), .align=alignof(Elem(T)));
+            a->capacity = new_cap;
+            std::memcpy(a->data, a->inline_buf, array_byte_size(a));
+            return;
+        }
+    }
+
     a->data     = mem_grow(a->mem, Elem(T), .size=(array_elem_size(a) * new_cap), .old_ptr=a->data, .old_size=(array_elem_size(a) * a->capacity));
     a->capacity = new_cap;
 }
@@ -123,11 +157,25 @@ Void array_ensure_count (T *a, U64 n, Bool zeroed) {
 // =============================================================================
 // Init:
 // =============================================================================
-template <typename T> Void     array_init     (T *a, Mem *mem)          { *a = { .mem=mem }; }
-template <typename T> Void     array_init_cap (T *a, Mem *mem, U64 cap) { array_init(a, mem); array_increase_capacity(a, cap); }
+template <typename T>
+Void array_init (T *a, Mem *mem) {
+    *a = { .mem=mem };
+
+    if constexpr (requires { a->inline_buf; }) {
+        a->data     = a->inline_buf;
+        a->capacity = sizeof(a->inline_buf) / array_elem_size(a);
+    }
+}
+
+template <typename T>
+Void array_free (T a) {
+    if constexpr (requires { a->inline_buf; }) if (a->data == a->inline_buf) return;
+    mem_free(a->mem, .old_ptr=a->data, .old_size=array_byte_size(a));
+}
+
+template <typename T> Void     array_init_cap (T *a, Mem *mem, U64 cap) { array_init(a, mem); array_ensure_capacity_min(a, cap); }
 template <typename T> Array<T> array_new      (Mem *mem)                { Array<T> a; array_init(&a, mem); return a; }
 template <typename T> Array<T> array_new_cap  (Mem *mem, U64 cap)       { Array<T> a; array_init_cap(&a, mem, cap); return a; }
-template <typename T> Void     array_free     (T a)                     { mem_free(a->mem, .old_ptr=a->data, .old_size=array_byte_size(a)); }
 
 // =============================================================================
 // Access:
@@ -153,16 +201,26 @@ inline Int c_compare (U8 *a, U8 *b)   { return (*a < *b) ? -1 : (*a > *b) ? 1 :
 inline Int c_compare (U32 *a, U32 *b) { return (*a < *b) ? -1 : (*a > *b) ? 1 : 0; }
 inline Int c_compare (U64 *a, U64 *b) { return (*a < *b) ? -1 : (*a > *b) ? 1 : 0; }
 
-template <typename T>
-Void array_sort_cmp (T *a, Int(*cmp)(Elem(T)*, Elem(T)*)) {
-    Auto fn = reinterpret_cast<int(*)(const Void *, const Void *)>(cmp);
-    std::qsort(a->data, a->count, array_elem_size(a), fn);
+// The comparator is any callable taking 2 element pointers and
+// returning an Int like c_compare. Passing it as a template arg
+// lets the compiler inline it into the sort loop.
+template <typename T, typename F>
+Void array_sort_cmp (T *a, const F &cmp) {
+    sort_pdq(a->data, a->count, cmp);
 }
 
-template <typename T> Void array_sort    (T *a)               { array_sort_cmp(a, c_compare); }
-template <typename T> Void array_swap    (T *a, U64 i, U64 j) { Elem(T) *e1=array_ref(a, i), *e2=array_ref(a, j), tmp=*e1; *e1=*e2; *e2=tmp; }
-template <typename T> Void array_reverse (T *a)               { for (U64 i=0; i < a->count/2; ++i) array_swap(a, i, a->count-i-1); }
-template <typename T> Void array_shuffle (T *a)               { array_iter (x, a) { x; swap(ARRAY->data[ARRAY_IDX], ARRAY->data[random_range(ARRAY_IDX, ARRAY->count)]); } }
+// The key_of function returns an unsigned key for an element;
+// see radix_key(). Best for large arrays of integer keys.
+template <typename T, typename F>
+Void array_sort_radix (T *a, const F &key_of) {
+    sort_radix(a->data, a->count, key_of);
+}
+
+template <typename T> Void array_sort       (T *a)               { array_sort_cmp(a, [](Auto x, Auto y){ return c_compare(x, y); }); }
+template <typename T> Void array_sort_radix (T *a)               { array_sort_radix(a, [](Auto x){ return radix_key(*x); }); }
+template <typename T> Void array_swap       (T *a, U64 i, U64 j) { Elem(T) *e1=array_ref(a, i), *e2=array_ref(a, j), tmp=*e1; *e1=*e2; *e2=tmp; }
+template <typename T> Void array_reverse    (T *a)               { for (U64 i=0; i < a->count/2; ++i) array_swap(a, i, a->count-i-1); }
+template <typename T> Void array_shuffle    (T *a)               { array_iter (x, a) { x; swap(ARRAY->data[ARRAY_IDX], ARRAY->data[random_range(ARRAY_IDX, ARRAY->count)]); } }
 
 // =============================================================================
 // Removal:
@@ -178,18 +236,18 @@ Void array_remove (T *a, U64 idx) {
     a->count--;
 }
 
-template <typename T> T    array_pop         (T *a)            { Auto r = array_get_last(a); a->count--; return r; }
-template <typename T> T    array_pop_or      (T *a, Elem(T) v) { return a->count ? array_pop(a) : v; }
-template <typename T> Void array_remove_fast (T *a, U64 i)     { array_set(a, i, array_get_last(a)); a->count--; }
-template <typename T> Void array_swap_remove (T *a, U64 i)     { array_swap(a, i, a->count-1); a->count--; }
+template <typename T> Elem(T) array_pop         (T *a)            { Auto r = array_get_last(a); a->count--; return r; }
+template <typename T> Elem(T) array_pop_or      (T *a, Elem(T) v) { return a->count ? array_pop(a) : v; }
+template <typename T> Void    array_remove_fast (T *a, U64 i)     { array_set(a, i, array_get_last(a)); a->count--; }
+template <typename T> Void    array_swap_remove (T *a, U64 i)     { array_swap(a, i, a->count-1); a->count--; }
 
 // =============================================================================
 // Search:
 // =============================================================================
 template <typename T>
 U64 array_bsearch (T *a, Elem(T) *elem, Int(*cmp)(Elem(T)*, Elem(T)*)) {
-    Void *p = std::bsearch(elem, a->data, a->count, array_elem_size(a), cmp);
-    return p ? (static_cast<U8*>(p) - a->data) / array_elem_size(a) : ARRAY_NIL_IDX;
+    Void *p = std::bsearch(elem, a->data, a->count, array_elem_size(a), reinterpret_cast<Int(*)(const Void*, const Void*)>(cmp));
+    return p ? (static_cast<Elem(T)*>(p) - a->data) : ARRAY_NIL_IDX;
 }
 
 template <typename T, typename F>
@@ -238,16 +296,55 @@ Void array_find_replace_all (T *a, const F &f, T r) {
     array_iter (it, a) if (f(it)) a->data[ARRAY_IDX] = r;
 }
 
+// The store is unconditional so that the loop has no
+// branch that depends on the predicate.
 template <typename T, typename F>
 Void array_find_remove_all (T *a, const F &f) {
     U64 n = 0;
-    array_iter (it, a) if (! f(it)) { a->data[n++] = it; }
+    array_iter (it, a) { a->data[n] = it; n += !f(it); }
     a->count = n;
 }
 
+// Integer, enum and pointer elements of 1, 4 or 8 bytes
+// are compared by value in simd.h kernels.
+template <typename T>
+constexpr Bool array_simd_elem = (std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>) &&
+                                 ((sizeof(T) == 1) || (sizeof(T) == 4) || (sizeof(T) == 8));
+
+template <typename T>
+U64 array_find_elem (T *a, Elem(T) e) {
+    using E = Elem(T);
+
+    if constexpr (array_simd_elem<E> && sizeof(E) == 1) {
+        return simd_find_u8(reinterpret_cast<U8*>(a->data), a->count, std::bit_cast<U8>(e));
+    } else if constexpr (array_simd_elem<E> && sizeof(E) == 4) {
+        return simd_find_u32(reinterpret_cast<U32*>(a->data), a->count, std::bit_cast<U32>(e));
+    } else if constexpr (array_simd_elem<E> && sizeof(E) == 8) {
+        return simd_find_u64(reinterpret_cast<U64*>(a->data), a->count, std::bit_cast<U64>(e));
+    } else {
+        return array_find(a, [&](Auto it){ return e == it; });
+    }
+}
+
+// Removes all elements equal to e keeping the order.
+template <typename T>
+Void array_find_remove_all_elem (T *a, Elem(T) e) {
+    using E = Elem(T);
+
+    if constexpr (array_simd_elem<E> && sizeof(E) == 1) {
+        a->count = simd_remove_u8(reinterpret_cast<U8*>(a->data), a->count, std::bit_cast<U8>(e));
+    } else if constexpr (array_simd_elem<E> && sizeof(E) == 4) {
+        a->count = simd_remove_u32(reinterpret_cast<U32*>(a->data), a->count, std::bit_cast<U32>(e));
+    } else if constexpr (array_simd_elem<E> && sizeof(E) == 8) {
+        a->count = simd_remove_u64(reinterpret_cast<U64*>(a->data), a->count, std::bit_cast<U64>(e));
+    } else {
+        array_find_remove_all(a, [&](Auto it){ return e == it; });
+    }
+}
+
 template <typename T>
 Bool array_has (T *a, Elem(T) e)  {
-    return !!array_find_ptr(a, [&](Auto it){ return e == *it; });
+    return array_find_elem(a, e) != ARRAY_NIL_IDX;
 }
 
 // =============================================================================
@@ -0,0 +1,124 @@
+#include <cstring>
+#include "base/bit_array.h"
+
+typedef U64 BitVec __attribute__((vector_size(32), aligned(8)));
+
+const U64 BIT_VEC_WORDS = sizeof(BitVec) / sizeof(U64);
+
+U64 bit_array_word_count (U64 count) {
+    return (count + 63) / 64;
+}
+
+// Zeroes the bits past the count in the last word.
+static Void clear_tail (BitArray *b) {
+    U64 rem = b->count % 64;
+    if (rem) b->words[b->count / 64] &= (1ull << rem) - 1;
+}
+
+Void bit_array_init (BitArray *b, Mem *mem, U64 count) {
+    *b = { .mem=mem };
+    bit_array_resize(b, count);
+}
+
+BitArray bit_array_new (Mem *mem, U64 count) {
+    BitArray b;
+    bit_array_init(&b, mem, count);
+    return b;
+}
+
+Void bit_array_free (BitArray *b) {
+    if (b->capacity) mem_free(b->mem, .old_ptr=b->words, .old_size=(b->capacity * sizeof(U64)));
+    *b = { .mem=b->mem };
+}
+
+// New bits are 0.
+Void bit_array_resize (BitArray *b, U64 count) {
+    U64 old_words = bit_array_word_count(b->count);
+    U64 new_words = bit_array_word_count(count);
+
+    if (new_words > b->capacity) {
+        U64 new_cap = max(new_words, 2 * b->capacity);
+        b->words    = mem_grow(b->mem, U64, .size=(new_cap * sizeof(U64)), .old_ptr=b->words, .old_size=(b->capacity * sizeof(U64)));
+        b->capacity = new_cap;
+    }
+
+    if (new_words > old_words) memset(&b->words[old_words], 0, (new_words - old_words) * sizeof(U64));
+    b->count = count;
+    clear_tail(b);
+}
+
+Void bit_array_set_all (BitArray *b) {
+    memset(b->words, 0xff, bit_array_word_count(b->count) * sizeof(U64));
+    clear_tail(b);
+}
+
+Void bit_array_clear_all (BitArray *b) {
+    memset(b->words, 0, bit_array_word_count(b->count) * sizeof(U64));
+}
+
+// The BitVec type is only 8 byte aligned, so it can be used to
+// load and store directly from the word buffer. The remaining
+// words are handled one at a time.
+#define BIT_ARRAY_BINOP(NAME, OP)\
+    Void NAME (BitArray *a, BitArray *b) {\
+        assert_always(a->count == b->count);\
+        U64 n = bit_array_word_count(a->count);\
+        U64 i = 0;\
+        for (; i + BIT_VEC_WORDS <= n; i += BIT_VEC_WORDS) {\
+            BitVec *x = reinterpret_cast<BitVec*>(&a->words[i]);\
+            BitVec  y = *reinterpret_cast<BitVec*>(&b->words[i]);\
+            *x = OP(*x, y);\
+        }\
+        for (; i < n; ++i) a->words[i] = OP(a->words[i], b->words[i]);\
+    }
+
+#define BIT_AND(X, Y)    ((X) & (Y))
+#define BIT_OR(X, Y)     ((X) | (Y))
+#define BIT_ANDNOT(X, Y) ((X) & ~(Y))
+#define BIT_XOR(X, Y)    ((X) ^ (Y))
+
+BIT_ARRAY_BINOP(bit_array_and, BIT_AND)
+BIT_ARRAY_BINOP(bit_array_or, BIT_OR)
+BIT_ARRAY_BINOP(bit_array_andnot, BIT_ANDNOT)
+BIT_ARRAY_BINOP(bit_array_xor, BIT_XOR)
+
+Void bit_array_not (BitArray *b) {
+    U64 n = bit_array_word_count(b->count);
+    U64 i = 0;
+
+    for (; i + BIT_VEC_WORDS <= n; i += BIT_VEC_WORDS) {
+        BitVec *x = reinterpret_cast<BitVec*>(&b->words[i]);
+        *x = ~*x;
+    }
+
+    for (; i < n; ++i) b->words[i] = ~b->words[i];
+    clear_tail(b);
+}
+
+U64 bit_array_popcount (BitArray *b) {
+    U64 n = bit_array_word_count(b->count);
+    U64 r = 0;
+    for (U64 i = 0; i < n; ++i) r += popcount(b->words[i]);
+    return r;
+}
+
+// Returns the index of the first set bit at or after the
+// given one or UINT64_MAX (ARRAY_NIL_IDX) if there is none.
+U64 bit_array_find_next (BitArray *b, U64 from) {
+    if (from >= b->count) return UINT64_MAX;
+
+    U64 n = bit_array_word_count(b->count);
+    U64 i = from / 64;
+    U64 w = b->words[i] & (~0ull << (from % 64));
+
+    while (! w) {
+        if (++i == n) return UINT64_MAX;
+        w = b->words[i];
+    }
+
+    return 64*i + __builtin_ctzll(w);
+}
+
+U64 bit_array_find_first (BitArray *b) {
+    return bit_array_find_next(b, 0);
+}
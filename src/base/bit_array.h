@@ -0,0 +1,62 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A dynamic array of bits packed into 64 bit words.
+//
+// The set algebra functions (and, or, andnot, xor) work in place
+// on the first operand and process 4 words per step with GCC
+// vector extensions, so filtering a list by several criteria is
+// a few vector ops per 256 items. Both operands must have the
+// same bit count.
+//
+// Bits past the count in the last word are always kept at 0,
+// which lets popcount and the find functions work on whole words.
+//
+// Usage example:
+// --------------
+//
+//     Auto done = bit_array_new(mem, items.count);
+//     Auto tagged = bit_array_new(mem, items.count);
+//     bit_array_set(&done, 3);
+//     bit_array_set(&tagged, 3);
+//     bit_array_and(&tagged, &done);
+//     bit_array_iter (idx, &tagged) printf("%lu\n", idx);
+//
+// =============================================================================
+#include "base/mem.h"
+
+struct BitArray {
+    U64 *words;
+    U64 count; // In bits.
+    U64 capacity; // In words.
+    Mem *mem;
+};
+
+#define bit_array_iter(X, B) let1(BIT_ARRAY, B)\
+                             for (U64 X = bit_array_find_next(BIT_ARRAY, 0); X != UINT64_MAX; X = bit_array_find_next(BIT_ARRAY, X + 1))
+
+Void     bit_array_init       (BitArray *, Mem *, U64 count);
+BitArray bit_array_new        (Mem *, U64 count);
+Void     bit_array_free       (BitArray *);
+Void     bit_array_resize     (BitArray *, U64 count);
+Void     bit_array_set_all    (BitArray *);
+Void     bit_array_clear_all  (BitArray *);
+Void     bit_array_and        (BitArray *, BitArray *);
+Void     bit_array_or         (BitArray *, BitArray *);
+Void     bit_array_andnot     (BitArray *, BitArray *);
+Void     bit_array_xor        (BitArray *, BitArray *);
+Void     bit_array_not        (BitArray *);
+U64      bit_array_popcount   (BitArray *);
+U64      bit_array_find_next  (BitArray *, U64 from);
+U64      bit_array_find_first (BitArray *);
+U64      bit_array_word_count (U64 count);
+
+inline Void bit_array_bounds_check (BitArray *b, U64 i)         { assert_always(i < b->count); }
+inline Bool bit_array_get          (BitArray *b, U64 i)         { bit_array_bounds_check(b, i); return (b->words[i / 64] >> (i % 64)) & 1; }
+inline Void bit_array_set          (BitArray *b, U64 i)         { bit_array_bounds_check(b, i); b->words[i / 64] |= (1ull << (i % 64)); }
+inline Void bit_array_clear        (BitArray *b, U64 i)         { bit_array_bounds_check(b, i); b->words[i / 64] &= ~(1ull << (i % 64)); }
+inline Void bit_array_toggle       (BitArray *b, U64 i)         { bit_array_bounds_check(b, i); b->words[i / 64] ^= (1ull << (i % 64)); }
+inline Void bit_array_put          (BitArray *b, U64 i, Bool v) { if (v) bit_array_set(b, i); else bit_array_clear(b, i); }
@@ -0,0 +1,519 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// An ordered map implemented as a B+tree. Values are stored only
+// in the leaves which are linked into a list, so iteration from
+// a lower bound is a walk along the leaves.
+//
+// Node capacities are derived from BTREE_NODE_SIZE so that each
+// node spans a few cache lines. Within a node keys are searched
+// linearly without branches since the nodes are small.
+//
+// This data structure is only suitable for POD types. Keys must
+// be unique and are ordered with the < operator.
+//
+// Usage example:
+// --------------
+//
+//     Auto tree = btree_new<U64, CString>(mem);
+//     btree_add(&tree, 10lu, "a");
+//     btree_add(&tree, 20lu, "b");
+//     btree_add(&tree, 30lu, "c");
+//
+//     // Prints entries in the range [15, 30).
+//     btree_iter_from (it, &tree, 15lu) {
+//         if (*btree_key(&it) >= 30) break;
+//         printf("%lu %s\n", *btree_key(&it), *btree_val(&it));
+//     }
+//
+// =============================================================================
+#include "base/array.h"
+
+const U64 BTREE_NODE_SIZE = 256;
+
+struct BTreeNode {
+    U16 count;
+    Bool is_leaf;
+};
+
+template <typename K, typename V>
+consteval U64 btree_leaf_cap () {
+    U64 header = sizeof(BTreeNode) + 2*sizeof(Void*);
+    U64 cap    = (BTREE_NODE_SIZE - min(header, BTREE_NODE_SIZE)) / (sizeof(K) + sizeof(V));
+    return max(cap, 4lu);
+}
+
+template <typename K>
+consteval U64 btree_inner_cap () {
+    U64 header = sizeof(BTreeNode) + sizeof(Void*);
+    U64 cap    = (BTREE_NODE_SIZE - min(header, BTREE_NODE_SIZE)) / (sizeof(K) + sizeof(Void*));
+    return max(cap, 4lu);
+}
+
+template <typename K, typename V>
+struct BTreeLeaf {
+    BTreeNode base;
+    BTreeLeaf *prev;
+    BTreeLeaf *next;
+    K keys[btree_leaf_cap<K, V>()];
+    V vals[btree_leaf_cap<K, V>()];
+};
+
+// The keys[i] separates children[i] and children[i+1]:
+// keys in children[i] < keys[i] <= keys in children[i+1].
+template <typename K>
+struct BTreeInner {
+    BTreeNode base;
+    K keys[btree_inner_cap<K>()];
+    BTreeNode *children[btree_inner_cap<K>() + 1];
+};
+
+template <typename K, typename V>
+struct BTree {
+    Mem *mem;
+    U64 count;
+    BTreeNode *root;
+    BTreeLeaf<K, V> *first;
+    BTreeLeaf<K, V> *last;
+};
+
+// An iterator is valid as long as leaf is not 0.
+// Any insertion or removal invalidates iterators.
+template <typename K, typename V>
+struct BTreeIter {
+    BTreeLeaf<K, V> *leaf;
+    U64 idx;
+};
+
+#define btree_iter(IT, T)         for (Auto IT = btree_first(T); IT.leaf; btree_next(&IT))
+#define btree_iter_from(IT, T, K) for (Auto IT = btree_lower_bound(T, K); IT.leaf; btree_next(&IT))
+
+#define BTREE_LEAF_CAP  (btree_leaf_cap<K, V>())
+#define BTREE_INNER_CAP (btree_inner_cap<K>())
+
+template <typename K, typename V> BTreeLeaf<K, V> *btree_as_leaf  (BTreeNode *n) { assert_dbg(n->is_leaf); return reinterpret_cast<BTreeLeaf<K, V>*>(n); }
+template <typename K>             BTreeInner<K>   *btree_as_inner (BTreeNode *n) { assert_dbg(!n->is_leaf); return reinterpret_cast<BTreeInner<K>*>(n); }
+
+template <typename K, typename V> K *btree_key (BTreeIter<K, V> *it) { return &it->leaf->keys[it->idx]; }
+template <typename K, typename V> V *btree_val (BTreeIter<K, V> *it) { return &it->leaf->vals[it->idx]; }
+
+// Number of keys in the node that are < key.
+template <typename K>
+U64 btree_rank (K *keys, U64 count, K key) {
+    U64 r = 0;
+    for (U64 i = 0; i < count; ++i) r += (keys[i] < key);
+    return r;
+}
+
+// Number of keys in the node that are <= key.
+template <typename K>
+U64 btree_rank_inclusive (K *keys, U64 count, K key) {
+    U64 r = 0;
+    for (U64 i = 0; i < count; ++i) r += !(key < keys[i]);
+    return r;
+}
+
+template <typename K, typename V>
+BTreeLeaf<K, V> *btree_new_leaf (BTree<K, V> *t) {
+    using Leaf = BTreeLeaf<K, V>;
+    Auto leaf  = mem_new(t->mem, Leaf);
+    leaf->base.is_leaf = true;
+    return leaf;
+}
+
+template <typename K, typename V>
+BTreeInner<K> *btree_new_inner (BTree<K, V> *t) {
+    return mem_new(t->mem, BTreeInner<K>);
+}
+
+template <typename K, typename V>
+Void btree_free_node (BTree<K, V> *t, BTreeNode *node) {
+    if (node->is_leaf) {
+        mem_free(t->mem, .old_ptr=node, .old_size=sizeof(BTreeLeaf<K, V>));
+    } else {
+        BTreeInner<K> *inner = btree_as_inner<K>(node);
+        for (U64 i = 0; i <= inner->base.count; ++i) btree_free_node(t, inner->children[i]);
+        mem_free(t->mem, .old_ptr=node, .old_size=sizeof(BTreeInner<K>));
+    }
+}
+
+// =============================================================================
+// Init:
+// =============================================================================
+template <typename K, typename V>
+Void btree_init (BTree<K, V> *t, Mem *mem) {
+    *t       = { .mem=mem };
+    t->first = btree_new_leaf(t);
+    t->last  = t->first;
+    t->root  = &t->first->base;
+}
+
+template <typename K, typename V>
+BTree<K, V> btree_new (Mem *mem) {
+    BTree<K, V> t;
+    btree_init(&t, mem);
+    return t;
+}
+
+template <typename K, typename V>
+Void btree_free (BTree<K, V> *t) {
+    btree_free_node(t, t->root);
+    *t = {};
+}
+
+// Builds the tree bottom up from keys that are sorted
+// and unique. The elements are spread evenly across the
+// nodes of each level so that every node is at least half
+// full without needing to rebalance afterwards.
+template <typename K, typename V>
+Void btree_init_from_sorted (BTree<K, V> *t, Mem *mem, Slice<K> keys, Slice<V> vals) {
+    assert_always(keys.count == vals.count);
+    btree_init(t, mem);
+    if (keys.count == 0) return;
+
+    tmem_new(tm);
+    Auto level = array_new<BTreeNode*>(tm);
+    Auto mins  = array_new<K>(tm); // Smallest key in each node of the level.
+
+    { // Leaves:
+        U64 n_leaves = ceil_div(keys.count, BTREE_LEAF_CAP);
+        U64 pos      = 0;
+        BTreeLeaf<K, V> *prev = 0;
+
+        for (U64 i = 0; i < n_leaves; ++i) {
+            U64 n = (keys.count / n_leaves) + (i < (keys.count % n_leaves));
+            BTreeLeaf<K, V> *leaf = (i == 0) ? t->first : btree_new_leaf(t);
+            leaf->base.count = n;
+            leaf->prev = prev;
+            if (prev) prev->next = leaf;
+            memcpy(leaf->keys, &keys.data[pos], n * sizeof(K));
+            memcpy(leaf->vals, &vals.data[pos], n * sizeof(V));
+            array_push(&level, &leaf->base);
+            array_push(&mins, keys.data[pos]);
+            pos += n;
+            prev = leaf;
+        }
+
+        t->last  = prev;
+        t->count = keys.count;
+    }
+
+    while (level.count > 1) { // Inner levels:
+        U64 fanout   = BTREE_INNER_CAP + 1;
+        U64 n_nodes  = ceil_div(level.count, fanout);
+        U64 pos      = 0;
+        U64 n_level  = 0;
+
+        for (U64 i = 0; i < n_nodes; ++i) {
+            U64 n = (level.count / n_nodes) + (i < (level.count % n_nodes));
+            BTreeInner<K> *inner = btree_new_inner(t);
+            inner->base.count = n - 1;
+            for (U64 j = 0; j < n; ++j) inner->children[j] = level.data[pos + j];
+            for (U64 j = 1; j < n; ++j) inner->keys[j - 1] = mins.data[pos + j];
+            K min_key = mins.data[pos];
+            level.data[n_level] = &inner->base; // Safe since n_level <= pos.
+            mins.data[n_level]  = min_key;
+            n_level++;
+            pos += n;
+        }
+
+        level.count = n_level;
+        mins.count  = n_level;
+    }
+
+    t->root = array_get(&level, 0);
+}
+
+// =============================================================================
+// Search:
+// =============================================================================
+template <typename K, typename V>
+BTreeIter<K, V> btree_first (BTree<K, V> *t) {
+    return { .leaf=(t->count ? t->first : 0), .idx=0 };
+}
+
+template <typename K, typename V>
+Void btree_next (BTreeIter<K, V> *it) {
+    if (++it->idx < it->leaf->base.count) return;
+    it->leaf = it->leaf->next;
+    it->idx  = 0;
+}
+
+template <typename K, typename V>
+Void btree_prev (BTreeIter<K, V> *it) {
+    if (it->idx--) return;
+    it->leaf = it->leaf->prev;
+    it->idx  = it->leaf ? it->leaf->base.count - 1 : 0;
+}
+
+template <typename K, typename V>
+BTreeLeaf<K, V> *btree_find_leaf (BTree<K, V> *t, K key) {
+    BTreeNode *node = t->root;
+
+    while (! node->is_leaf) {
+        BTreeInner<K> *inner = btree_as_inner<K>(node);
+        node = inner->children[btree_rank_inclusive(inner->keys, inner->base.count, key)];
+    }
+
+    return btree_as_leaf<K, V>(node);
+}
+
+// Returns an iterator to the first entry with key >= the
+// given key. The iterator is invalid if there is none.
+template <typename K, typename V>
+BTreeIter<K, V> btree_lower_bound (BTree<K, V> *t, K key) {
+    BTreeLeaf<K, V> *leaf = btree_find_leaf(t, key);
+    BTreeIter<K, V> it = { .leaf=leaf, .idx=btree_rank(leaf->keys, leaf->base.count, key) };
+    if (it.idx == leaf->base.count) { it.leaf = leaf->next; it.idx = 0; }
+    return it;
+}
+
+template <typename K, typename V>
+Bool btree_get (BTree<K, V> *t, K key, V *out_val) {
+    BTreeLeaf<K, V> *leaf = btree_find_leaf(t, key);
+    U64 idx = btree_rank(leaf->keys, leaf->base.count, key);
+    if ((idx == leaf->base.count) || (key < leaf->keys[idx])) return false;
+    if (out_val) *out_val = leaf->vals[idx];
+    return true;
+}
+
+// =============================================================================
+// Insertion:
+// =============================================================================
+template <typename K, typename V>
+struct BTreeSplit {
+    BTreeNode *node; // 0 if there was no split.
+    K key;           // Smallest key in the subtree of node.
+};
+
+template <typename T>
+Void btree_insert_at (T *items, U64 count, U64 idx, T item) {
+    memmove(&items[idx + 1], &items[idx], (count - idx) * sizeof(T));
+    items[idx] = item;
+}
+
+template <typename T>
+Void btree_remove_at (T *items, U64 count, U64 idx) {
+    memmove(&items[idx], &items[idx + 1], (count - idx - 1) * sizeof(T));
+}
+
+template <typename K, typename V>
+BTreeSplit<K, V> btree_add_rec (BTree<K, V> *t, BTreeNode *node, K key, V val, Bool *found) {
+    if (node->is_leaf) {
+        BTreeLeaf<K, V> *leaf = btree_as_leaf<K, V>(node);
+        U64 n   = leaf->base.count;
+        U64 idx = btree_rank(leaf->keys, n, key);
+
+        if ((idx < n) && !(key < leaf->keys[idx])) { *found = true; return {}; }
+
+        if (n < BTREE_LEAF_CAP) {
+            btree_insert_at(leaf->keys, n, idx, key);
+            btree_insert_at(leaf->vals, n, idx, val);
+            leaf->base.count++;
+            return {};
+        }
+
+        BTreeLeaf<K, V> *right = btree_new_leaf(t);
+        U64 half = (n + 1) / 2;
+        right->base.count = n - half;
+        leaf->base.count  = half;
+        memcpy(right->keys, &leaf->keys[half], right->base.count * sizeof(K));
+        memcpy(right->vals, &leaf->vals[half], right->base.count * sizeof(V));
+
+        right->next = leaf->next;
+        right->prev = leaf;
+        if (leaf->next) leaf->next->prev = right;
+        else            t->last = right;
+        leaf->next = right;
+
+        BTreeLeaf<K, V> *target = (idx <= half) ? leaf : right;
+        U64 target_idx = (idx <= half) ? idx : idx - half;
+        btree_insert_at(target->keys, target->base.count, target_idx, key);
+        btree_insert_at(target->vals, target->base.count, target_idx, val);
+        target->base.count++;
+
+        return { .node=&right->base, .key=right->keys[0] };
+    }
+
+    BTreeInner<K> *inner = btree_as_inner<K>(node);
+    U64 child_idx = btree_rank_inclusive(inner->keys, inner->base.count, key);
+    BTreeSplit<K, V> split = btree_add_rec(t, inner->children[child_idx], key, val, found);
+    if (! split.node) return {};
+
+    U64 n = inner->base.count;
+
+    if (n < BTREE_INNER_CAP) {
+        btree_insert_at(inner->keys, n, child_idx, split.key);
+        btree_insert_at(inner->children, n + 1, child_idx + 1, split.node);
+        inner->base.count++;
+        return {};
+    }
+
+    // Split a full inner node. We first build the overfull key
+    // and child lists in temporary buffers, then the middle key
+    // moves up into the parent.
+    K keys[BTREE_INNER_CAP + 1];
+    BTreeNode *children[BTREE_INNER_CAP + 2];
+    memcpy(keys, inner->keys, n * sizeof(K));
+    memcpy(children, inner->children, (n + 1) * sizeof(BTreeNode*));
+    btree_insert_at(keys, n, child_idx, split.key);
+    btree_insert_at(children, n + 1, child_idx + 1, split.node);
+
+    U64 total = n + 1;
+    U64 mid   = total / 2;
+    BTreeInner<K> *right = btree_new_inner(t);
+
+    inner->base.count = mid;
+    memcpy(inner->keys, keys, mid * sizeof(K));
+    memcpy(inner->children, children, (mid + 1) * sizeof(BTreeNode*));
+
+    right->base.count = total - mid - 1;
+    memcpy(right->keys, &keys[mid + 1], right->base.count * sizeof(K));
+    memcpy(right->children, &children[mid + 1], (right->base.count + 1) * sizeof(BTreeNode*));
+
+    return { .node=&right->base, .key=keys[mid] };
+}
+
+// Returns true if the key was already in the tree in
+// which case the value is *not* overwritten.
+template <typename K, typename V>
+Bool btree_add (BTree<K, V> *t, K key, V val) {
+    Bool found = false;
+    BTreeSplit<K, V> split = btree_add_rec(t, t->root, key, val, &found);
+
+    if (split.node) {
+        BTreeInner<K> *root = btree_new_inner(t);
+        root->base.count  = 1;
+        root->keys[0]     = split.key;
+        root->children[0] = t->root;
+        root->children[1] = split.node;
+        t->root = &root->base;
+    }
+
+    if (! found) t->count++;
+    return found;
+}
+
+// =============================================================================
+// Removal:
+// =============================================================================
+template <typename K, typename V>
+Void btree_fix_leaf_underflow (BTree<K, V> *t, BTreeInner<K> *parent, U64 idx) {
+    BTreeLeaf<K, V> *leaf  = btree_as_leaf<K, V>(parent->children[idx]);
+    BTreeLeaf<K, V> *left  = (idx > 0) ? btree_as_leaf<K, V>(parent->children[idx - 1]) : 0;
+    BTreeLeaf<K, V> *right = (idx < parent->base.count) ? btree_as_leaf<K, V>(parent->children[idx + 1]) : 0;
+    U64 min_count = BTREE_LEAF_CAP / 2;
+
+    if (left && (left->base.count > min_count)) {
+        U64 n = left->base.count - 1;
+        btree_insert_at(leaf->keys, leaf->base.count, 0, left->keys[n]);
+        btree_insert_at(leaf->vals, leaf->base.count, 0, left->vals[n]);
+        leaf->base.count++;
+        left->base.count--;
+        parent->keys[idx - 1] = leaf->keys[0];
+    } else if (right && (right->base.count > min_count)) {
+        leaf->keys[leaf->base.count] = right->keys[0];
+        leaf->vals[leaf->base.count] = right->vals[0];
+        leaf->base.count++;
+        btree_remove_at(right->keys, right->base.count, 0);
+        btree_remove_at(right->vals, right->base.count, 0);
+        right->base.count--;
+        parent->keys[idx] = right->keys[0];
+    } else {
+        // Merge with a sibling; the right one of the pair is freed.
+        if (left) { right = leaf; leaf = left; idx--; }
+        memcpy(&leaf->keys[leaf->base.count], right->keys, right->base.count * sizeof(K));
+        memcpy(&leaf->vals[leaf->base.count], right->vals, right->base.count * sizeof(V));
+        leaf->base.count += right->base.count;
+        leaf->next = right->next;
+        if (right->next) right->next->prev = leaf;
+        else             t->last = leaf;
+        btree_remove_at(parent->keys, parent->base.count, idx);
+        btree_remove_at(parent->children, parent->base.count + 1, idx + 1);
+        parent->base.count--;
+        mem_free(t->mem, .old_ptr=right, .old_size=sizeof(BTreeLeaf<K, V>));
+    }
+}
+
+template <typename K, typename V>
+Void btree_fix_inner_underflow (BTree<K, V> *t, BTreeInner<K> *parent, U64 idx) {
+    BTreeInner<K> *node  = btree_as_inner<K>(parent->children[idx]);
+    BTreeInner<K> *left  = (idx > 0) ? btree_as_inner<K>(parent->children[idx - 1]) : 0;
+    BTreeInner<K> *right = (idx < parent->base.count) ? btree_as_inner<K>(parent->children[idx + 1]) : 0;
+    U64 min_count = BTREE_INNER_CAP / 2;
+
+    if (left && (left->base.count > min_count)) {
+        U64 n = left->base.count;
+        btree_insert_at(node->keys, node->base.count, 0, parent->keys[idx - 1]);
+        btree_insert_at(node->children, node->base.count + 1, 0, left->children[n]);
+        node->base.count++;
+        parent->keys[idx - 1] = left->keys[n - 1];
+        left->base.count--;
+    } else if (right && (right->base.count > min_count)) {
+        node->keys[node->base.count] = parent->keys[idx];
+        node->children[node->base.count + 1] = right->children[0];
+        node->base.count++;
+        parent->keys[idx] = right->keys[0];
+        btree_remove_at(right->keys, right->base.count, 0);
+        btree_remove_at(right->children, right->base.count + 1, 0);
+        right->base.count--;
+    } else {
+        if (left) { right = node; node = left; idx--; }
+        U64 n = node->base.count;
+        node->keys[n] = parent->keys[idx];
+        memcpy(&node->keys[n + 1], right->keys, right->base.count * sizeof(K));
+        memcpy(&node->children[n + 1], right->children, (right->base.count + 1) * sizeof(BTreeNode*));
+        node->base.count += right->base.count + 1;
+        btree_remove_at(parent->keys, parent->base.count, idx);
+        btree_remove_at(parent->children, parent->base.count + 1, idx + 1);
+        parent->base.count--;
+        mem_free(t->mem, .old_ptr=right, .old_size=sizeof(BTreeInner<K>));
+    }
+}
+
+template <typename K, typename V>
+Bool btree_remove_rec (BTree<K, V> *t, BTreeNode *node, K key) {
+    if (node->is_leaf) {
+        BTreeLeaf<K, V> *leaf = btree_as_leaf<K, V>(node);
+        U64 idx = btree_rank(leaf->keys, leaf->base.count, key);
+        if ((idx == leaf->base.count) || (key < leaf->keys[idx])) return false;
+        btree_remove_at(leaf->keys, leaf->base.count, idx);
+        btree_remove_at(leaf->vals, leaf->base.count, idx);
+        leaf->base.count--;
+        return true;
+    }
+
+    BTreeInner<K> *inner = btree_as_inner<K>(node);
+    U64 idx = btree_rank_inclusive(inner->keys, inner->base.count, key);
+    BTreeNode *child = inner->children[idx];
+    if (! btree_remove_rec(t, child, key)) return false;
+
+    if (child->is_leaf) {
+        if (child->count < (BTREE_LEAF_CAP / 2)) btree_fix_leaf_underflow(t, inner, idx);
+    } else {
+        if (child->count < (BTREE_INNER_CAP / 2)) btree_fix_inner_underflow(t, inner, idx);
+    }
+
+    return true;
+}
+
+// Returns true if the key was found and removed.
+template <typename K, typename V>
+Bool btree_remove (BTree<K, V> *t, K key) {
+    if (! btree_remove_rec(t, t->root, key)) return false;
+    t->count--;
+
+    if (!t->root->is_leaf && (t->root->count == 0)) {
+        BTreeNode *old_root = t->root;
+        t->root = btree_as_inner<K>(old_root)->children[0];
+        mem_free(t->mem, .old_ptr=old_root, .old_size=sizeof(BTreeInner<K>));
+    }
+
+    return true;
+}
+
+#undef BTREE_LEAF_CAP
+#undef BTREE_INNER_CAP
@@ -0,0 +1,196 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A bounded LRU cache for derived data (formatted strings,
+// rendered rows, ...). It's a Map from keys to nodes which
+// are also linked into an intrusive recency list.
+//
+// Each entry is added with a cost (usually its size in bytes)
+// and the least recently used entries get evicted whenever
+// the sum of costs exceeds the budget.
+//
+// Nodes come from a pool that is refilled in chunks, so there
+// is no allocation per insertion. The cache does not copy the
+// keys or values; if they point to memory, the on_evict hook
+// is a good place to release it since it's called for every
+// entry that leaves the cache (eviction, replacement, removal
+// and clearing).
+//
+// This data structure is only suitable for POD types. Like in
+// Map, the key type needs overloaded hash/compare functions.
+//
+// Usage example:
+// --------------
+//
+//     Auto cache = cache_new<U64, String>(mem, 64*KB);
+//     cache_add(&cache, 42lu, str("foo"), 3);
+//
+//     String s;
+//     if (cache_get(&cache, 42lu, &s)) printf("%.*s\n", STR(s));
+//     printf("hits=%lu misses=%lu\n", cache.hits, cache.misses);
+//
+// =============================================================================
+#include "base/map.h"
+
+const U64 CACHE_POOL_CHUNK = 64;
+
+template <typename Key, typename Val>
+struct CacheNode {
+    Key key;
+    Val val;
+    U64 cost;
+    CacheNode *prev; // Towards the most recently used.
+    CacheNode *next; // Towards the least recently used.
+};
+
+template <typename Key, typename Val>
+struct CachePoolChunk {
+    CachePoolChunk *next;
+    CacheNode<Key, Val> nodes[CACHE_POOL_CHUNK];
+};
+
+template <typename Key, typename Val>
+struct Cache {
+    Mem *mem;
+    Map<Key, CacheNode<Key, Val>*> map;
+    CacheNode<Key, Val> *head; // Most recently used.
+    CacheNode<Key, Val> *tail; // Least recently used.
+    CacheNode<Key, Val> *free_nodes;
+    CachePoolChunk<Key, Val> *chunks;
+    U64 budget;
+    U64 used;
+    U64 hits;
+    U64 misses;
+    U64 evictions;
+    Void *on_evict_ctx;
+    Void (*on_evict) (Void *ctx, Key, Val);
+};
+
+template <typename Key, typename Val>
+CacheNode<Key, Val> *cache_node_alloc (Cache<Key, Val> *c) {
+    if (! c->free_nodes) {
+        using Chunk = CachePoolChunk<Key, Val>;
+        Chunk *chunk = mem_new(c->mem, Chunk);
+        chunk->next  = c->chunks;
+        c->chunks    = chunk;
+        for (U64 i = 0; i < CACHE_POOL_CHUNK; ++i) { chunk->nodes[i].next = c->free_nodes; c->free_nodes = &chunk->nodes[i]; }
+    }
+
+    CacheNode<Key, Val> *node = c->free_nodes;
+    c->free_nodes = node->next;
+    return node;
+}
+
+template <typename Key, typename Val>
+Void cache_unlink (Cache<Key, Val> *c, CacheNode<Key, Val> *node) {
+    if (node->prev) node->prev->next = node->next;
+    else            c->head = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else            c->tail = node->prev;
+}
+
+template <typename Key, typename Val>
+Void cache_link_front (Cache<Key, Val> *c, CacheNode<Key, Val> *node) {
+    node->prev = 0;
+    node->next = c->head;
+    if (c->head) c->head->prev = node;
+    else         c->tail = node;
+    c->head = node;
+}
+
+// Drops the node from the list, map and budget, and
+// then returns it to the pool.
+template <typename Key, typename Val>
+Void cache_drop (Cache<Key, Val> *c, CacheNode<Key, Val> *node) {
+    cache_unlink(c, node);
+    map_remove(&c->map, node->key);
+    c->used -= node->cost;
+    if (c->on_evict) c->on_evict(c->on_evict_ctx, node->key, node->val);
+    node->next = c->free_nodes;
+    c->free_nodes = node;
+}
+
+template <typename Key, typename Val>
+Void cache_init (Cache<Key, Val> *c, Mem *mem, U64 budget) {
+    *c = { .mem=mem, .budget=budget };
+    map_init(&c->map, mem, 0);
+}
+
+template <typename Key, typename Val>
+Cache<Key, Val> cache_new (Mem *mem, U64 budget) {
+    Cache<Key, Val> c;
+    cache_init(&c, mem, budget);
+    return c;
+}
+
+template <typename Key, typename Val>
+Void cache_clear (Cache<Key, Val> *c) {
+    while (c->tail) cache_drop(c, c->tail);
+}
+
+template <typename Key, typename Val>
+Void cache_free (Cache<Key, Val> *c) {
+    cache_clear(c);
+
+    for (Auto chunk = c->chunks; chunk;) {
+        Auto next = chunk->next;
+        mem_free(c->mem, .old_ptr=chunk, .old_size=sizeof(*chunk));
+        chunk = next;
+    }
+
+    mem_free(c->mem, .old_ptr=c->map.entries, .old_size=(c->map.capacity * sizeof(*c->map.entries)));
+    *c = {};
+}
+
+// On a hit the entry becomes the most recently used one.
+template <typename Key, typename Val>
+Bool cache_get (Cache<Key, Val> *c, Key key, Val *out_val) {
+    CacheNode<Key, Val> *node = 0;
+
+    if (! map_get(&c->map, key, &node)) {
+        c->misses++;
+        return false;
+    }
+
+    c->hits++;
+    if (node != c->head) { cache_unlink(c, node); cache_link_front(c, node); }
+    if (out_val) *out_val = node->val;
+    return true;
+}
+
+// Adds or replaces the entry for the key, evicting least
+// recently used entries until the cost fits the budget.
+// Entries that cost more than the whole budget are not
+// added, in which case false is returned.
+template <typename Key, typename Val>
+Bool cache_add (Cache<Key, Val> *c, Key key, Val val, U64 cost) {
+    CacheNode<Key, Val> *old = 0;
+    if (map_get(&c->map, key, &old)) cache_drop(c, old);
+
+    if (cost > c->budget) return false;
+
+    while ((c->used + cost) > c->budget) {
+        cache_drop(c, c->tail);
+        c->evictions++;
+    }
+
+    CacheNode<Key, Val> *node = cache_node_alloc(c);
+    node->key  = key;
+    node->val  = val;
+    node->cost = cost;
+    cache_link_front(c, node);
+    map_add(&c->map, key, node);
+    c->used += cost;
+    return true;
+}
+
+template <typename Key, typename Val>
+Bool cache_remove (Cache<Key, Val> *c, Key key) {
+    CacheNode<Key, Val> *node = 0;
+    if (! map_get(&c->map, key, &node)) return false;
+    cache_drop(c, node);
+    return true;
+}
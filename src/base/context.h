@@ -13,6 +13,9 @@
 //     OS_LINUX
 //     OS_WINDOWS
 //
+//     ARCH_X64
+//     ARCH_ARM64
+//
 //     IF_BUILD_DEBUG
 //     IF_BUILD_RELEASE
 //
@@ -41,6 +44,12 @@
     #error "Unsupported compiler."
 #endif
 
+#if defined(__x86_64__)
+    #define ARCH_X64 1
+#elif defined(__aarch64__)
+    #define ARCH_ARM64 1
+#endif
+
 // =============================================================================
 // Short form IF_BUILD() macros:
 // =============================================================================
@@ -67,3 +76,9 @@
 #if !defined(OS_LINUX)
     #define OS_LINUX 0
 #endif
+#if !defined(ARCH_X64)
+    #define ARCH_X64 0
+#endif
+#if !defined(ARCH_ARM64)
+    #define ARCH_ARM64 0
+#endif
@@ -165,6 +165,7 @@ struct Defer {
 U8 count_digits (U64);
 
 // Integer hashing.
+U64 hash_mix (U64, U64); // 128-bit multiply folded to 64 bits.
 U64 hash (U32);
 U64 hash (U64);
 U64 hash (I32);
@@ -179,7 +180,7 @@ U64 rotl64 (U64 x, U64 r);
 U64 padding_to_align (U64 x, U64 a);
 
 #if COMPILER_CLANG || COMPILER_GCC
-    #define atomic_load(X)               __atomic_load(X, __ATOMIC_SEQ_CST)
+    #define atomic_load(X)               __atomic_load_n(X, __ATOMIC_SEQ_CST)
     #define atomic_inc_load(X)           (__atomic_fetch_add(X, 1, __ATOMIC_SEQ_CST) + 1)
     #define atomic_dec_load(X)           (__atomic_fetch_add(X, 1, __ATOMIC_SEQ_CST) - 1)
     #define atomic_exchange(X, C)        __atomic_exchange_n(X, C, __ATOMIC_SEQ_CST)
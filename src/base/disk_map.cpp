@@ -0,0 +1,122 @@
+#include "base/disk_map.h"
+#include "os/fs.h"
+
+static U8 ctrl_byte (U64 hash) {
+    return 0x80 | (hash >> 57);
+}
+
+static U64 entry_size (U64 val_size) {
+    U64 size = sizeof(DiskMapEntry) + val_size;
+    return size + padding_to_align(size, alignof(DiskMapEntry));
+}
+
+Bool disk_map_open (DiskMap *dm, String path, U64 val_size) {
+    *dm = {};
+
+    String file = fs_map_file(path);
+    if (file.count < sizeof(DiskMapHeader)) { fs_unmap_file(file); return false; }
+
+    Auto h = reinterpret_cast<DiskMapHeader*>(file.data);
+    U64 n  = file.count;
+
+    Bool ok = (h->magic == DISK_MAP_MAGIC) &&
+              (h->version == DISK_MAP_VERSION) &&
+              (h->val_size == val_size) &&
+              (h->entry_size == entry_size(val_size)) &&
+              (h->file_size == n) &&
+              (h->capacity > 0) && is_pow2(h->capacity) && (h->count < h->capacity) &&
+              (h->ctrl_offset >= sizeof(DiskMapHeader)) && (h->ctrl_offset <= n) && (h->capacity <= (n - h->ctrl_offset)) &&
+              (h->entries_offset % alignof(DiskMapEntry) == 0) && (h->entries_offset <= n) && (h->capacity <= ((n - h->entries_offset) / h->entry_size)) &&
+              (h->blob_offset <= n) && (h->blob_size <= (n - h->blob_offset));
+
+    if (! ok) { fs_unmap_file(file); return false; }
+
+    dm->file    = file;
+    dm->header  = h;
+    dm->ctrl    = reinterpret_cast<U8*>(file.data + h->ctrl_offset);
+    dm->entries = reinterpret_cast<U8*>(file.data + h->entries_offset);
+    dm->blob    = file.data + h->blob_offset;
+    return true;
+}
+
+Void disk_map_close (DiskMap *dm) {
+    fs_unmap_file(dm->file);
+    *dm = {};
+}
+
+// Returns a pointer to the value inside the mapped file
+// or 0 if not found. The pointer is 8 byte aligned.
+Void *disk_map_get_raw (DiskMap *dm, String key) {
+    DiskMapHeader *h = dm->header;
+    U64 hash = max(str_hash(key), MAP_HASH_OF_FILLED_ENTRY);
+    U8 ctrl  = ctrl_byte(hash);
+    U64 mask = h->capacity - 1;
+    U64 idx  = hash & mask;
+
+    for (U64 inc = 1; inc <= h->capacity; ++inc) {
+        U8 c = dm->ctrl[idx];
+        if (c == 0) return 0;
+
+        if (c == ctrl) {
+            Auto entry = reinterpret_cast<DiskMapEntry*>(dm->entries + (idx * h->entry_size));
+
+            if ((entry->hash == hash) && (entry->key_count == key.count) && (entry->key_offset <= h->blob_size) && (entry->key_count <= (h->blob_size - entry->key_offset))) {
+                if (! memcmp(dm->blob + entry->key_offset, key.data, key.count)) return entry + 1;
+            }
+        }
+
+        idx = (idx + inc) & mask;
+    }
+
+    return 0;
+}
+
+Bool disk_map_write_raw (String path, Slice<String> keys, U8 *vals, U64 val_size) {
+    assert_always(val_size <= UINT32_MAX); // Stored as U32 in the header.
+    tmem_new(tm);
+
+    U64 cap       = max(MIN_CAPACITY, next_pow2(safe_mul(keys.count, 100lu) / MAX_LOAD + 1));
+    U64 esize     = entry_size(val_size);
+    U64 blob_size = 0;
+    array_iter (key, &keys) blob_size = safe_add(blob_size, key.count);
+
+    DiskMapHeader h = {};
+    h.magic          = DISK_MAP_MAGIC;
+    h.version        = DISK_MAP_VERSION;
+    h.val_size       = static_cast<U32>(val_size);
+    h.capacity       = cap;
+    h.count          = keys.count;
+    h.entry_size     = esize;
+    h.ctrl_offset    = sizeof(DiskMapHeader);
+    h.entries_offset = h.ctrl_offset + cap;
+    h.entries_offset += padding_to_align(h.entries_offset, alignof(DiskMapEntry));
+    h.blob_offset    = h.entries_offset + safe_mul(cap, esize);
+    h.blob_size      = blob_size;
+    h.file_size      = h.blob_offset + blob_size;
+
+    Auto buf = mem_alloc(tm, U8, .zeroed=true, .size=h.file_size);
+    memcpy(buf, &h, sizeof(h));
+
+    U8 *ctrl     = buf + h.ctrl_offset;
+    U8 *entries  = buf + h.entries_offset;
+    U8 *blob     = buf + h.blob_offset;
+    U64 blob_pos = 0;
+
+    array_iter (key, &keys) {
+        U64 hash = max(str_hash(key), MAP_HASH_OF_FILLED_ENTRY);
+        U64 mask = cap - 1;
+        U64 idx  = hash & mask;
+        U64 inc  = 1;
+
+        while (ctrl[idx]) { idx = (idx + inc) & mask; inc++; }
+
+        ctrl[idx] = ctrl_byte(hash);
+        DiskMapEntry entry = { .hash=hash, .key_offset=blob_pos, .key_count=key.count };
+        memcpy(entries + (idx * esize), &entry, sizeof(entry));
+        memcpy(entries + (idx * esize) + sizeof(entry), vals + (ARRAY_IDX * val_size), val_size);
+        if (key.count) memcpy(blob + blob_pos, key.data, key.count);
+        blob_pos += key.count;
+    }
+
+    return fs_write_entire_file(path, (String){ .data=reinterpret_cast<Char*>(buf), .count=h.file_size });
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A read-only hash table with String keys that lives in a file
+// and is used directly from the mapped pages. Opening it is an
+// mmap plus a header check; there is no deserialization step.
+//
+// The file layout is flat and position independent (all links
+// are offsets from the start of the file):
+//
+//     [DiskMapHeader]
+//     [control bytes]  One per slot: 0 for empty, else 0x80 | top 7 hash bits.
+//     [entries]        One per slot: DiskMapEntry followed by the value bytes.
+//     [string blob]    Key bytes referenced by the entries.
+//
+// Probing is the same as in map.h: quadratic via triangular
+// numbers over a power of 2 capacity. The control bytes are
+// scanned first so that most misses never touch the entries.
+//
+// Values are copied in and out with memcpy, so they must be
+// POD types without pointers. The file is native endian.
+//
+// Usage example:
+// --------------
+//
+//     Auto map = map_new<String, U64>(mem, 0);
+//     map_add(&map, str("foo"), 42lu);
+//     disk_map_write(str("index.bin"), &map);
+//
+//     DiskMap dm;
+//     if (disk_map_open(&dm, str("index.bin"), sizeof(U64))) {
+//         U64 val;
+//         if (disk_map_get(&dm, str("foo"), &val)) printf("%lu\n", val);
+//         disk_map_close(&dm);
+//     }
+//
+// =============================================================================
+#include "base/string.h"
+#include "base/map.h"
+
+const U64 DISK_MAP_MAGIC   = 0x50414d444d4e524bull; // "KRNMDMAP"
+const U32 DISK_MAP_VERSION = 1; // Bump when the layout or str_hash() changes.
+
+struct DiskMapHeader {
+    U64 magic;
+    U32 version;
+    U32 val_size;
+    U64 capacity;
+    U64 count;
+    U64 entry_size;
+    U64 ctrl_offset;
+    U64 entries_offset;
+    U64 blob_offset;
+    U64 blob_size;
+    U64 file_size;
+};
+
+struct DiskMapEntry {
+    U64 hash;
+    U64 key_offset; // Relative to blob start.
+    U64 key_count;
+};
+
+struct DiskMap {
+    String file;
+    DiskMapHeader *header;
+    U8 *ctrl;
+    U8 *entries;
+    Char *blob;
+};
+
+Bool  disk_map_open      (DiskMap *, String path, U64 val_size);
+Void  disk_map_close     (DiskMap *);
+Void *disk_map_get_raw   (DiskMap *, String key);
+Bool  disk_map_write_raw (String path, Slice<String> keys, U8 *vals, U64 val_size);
+
+template <typename Val>
+Bool disk_map_get (DiskMap *dm, String key, Val *out_val) {
+    assert_dbg(dm->header->val_size == sizeof(Val));
+    Void *p = disk_map_get_raw(dm, key);
+    if (p && out_val) memcpy(out_val, p, sizeof(Val));
+    return p;
+}
+
+template <typename Val>
+Bool disk_map_write (String path, Map<String, Val> *map) {
+    tmem_new(tm);
+    Auto keys = array_new_cap<String>(tm, map->count + 1);
+    Auto vals = array_new_cap<Val>(tm, map->count + 1);
+    map_iter (e, map) { array_push(&keys, e->key); array_push(&vals, e->val); }
+    return disk_map_write_raw(path, slice(&keys), reinterpret_cast<U8*>(vals.data), sizeof(Val));
+}
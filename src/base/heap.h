@@ -0,0 +1,231 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A d-ary min heap (priority queue) built on Array.
+//
+// The Cmp type is a stateless callable with the c_compare
+// convention; the element for which it reports the smallest
+// value is at the top. The default arity of 4 makes the heap
+// shallower than a binary one and keeps all children of a node
+// within one or two cache lines.
+//
+// Every pushed element gets a handle which stays valid until the
+// element leaves the heap. Handles allow changing the priority of
+// an element (decrease-key) or removing it from the middle.
+//
+// This data structure is only suitable for POD types.
+//
+// Usage example:
+// --------------
+//
+//     struct Timer { U64 deadline; U64 id; };
+//     using TimerCmp = decltype([](Timer *a, Timer *b){ return c_compare(&a->deadline, &b->deadline); });
+//
+//     Auto timers = heap_new<Timer, TimerCmp>(mem);
+//     HeapHandle h = heap_push(&timers, Timer{ 100, 1 });
+//     heap_push(&timers, Timer{ 200, 2 });
+//     heap_update(&timers, h, Timer{ 300, 1 });
+//     Timer next = heap_pop(&timers); // id = 2
+//
+// =============================================================================
+#include "base/array.h"
+
+typedef U32 HeapHandle;
+
+const U32 HEAP_NIL_POS = UINT32_MAX;
+
+struct HeapCmp {
+    template <typename T> Int operator() (T *a, T *b) const { return c_compare(a, b); }
+};
+
+template <typename Cmp>
+struct HeapCmpReverse {
+    template <typename T> Int operator() (T *a, T *b) const { return Cmp{}(b, a); }
+};
+
+template <typename T>
+struct HeapNode {
+    T val;
+    HeapHandle handle;
+};
+
+template <typename T, typename Cmp = HeapCmp, U64 Arity = 4>
+struct Heap {
+    Array<HeapNode<T>> nodes;
+    Array<U32> positions; // Node idx by handle or HEAP_NIL_POS.
+    Array<HeapHandle> free_handles;
+};
+
+template <typename T, typename Cmp, U64 Arity> Bool heap_less  (Heap<T, Cmp, Arity> *h, T *a, T *b) { return Cmp{}(a, b) < 0; }
+template <typename T, typename Cmp, U64 Arity> Void heap_place (Heap<T, Cmp, Arity> *h, U64 idx, HeapNode<T> node) { h->nodes.data[idx] = node; h->positions.data[node.handle] = idx; }
+
+template <typename T, typename Cmp, U64 Arity>
+Void heap_sift_up (Heap<T, Cmp, Arity> *h, U64 idx) {
+    HeapNode<T> node = h->nodes.data[idx];
+
+    while (idx > 0) {
+        U64 parent = (idx - 1) / Arity;
+        if (! heap_less(h, &node.val, &h->nodes.data[parent].val)) break;
+        heap_place(h, idx, h->nodes.data[parent]);
+        idx = parent;
+    }
+
+    heap_place(h, idx, node);
+}
+
+template <typename T, typename Cmp, U64 Arity>
+Void heap_sift_down (Heap<T, Cmp, Arity> *h, U64 idx) {
+    HeapNode<T> node = h->nodes.data[idx];
+    U64 count = h->nodes.count;
+
+    while (true) {
+        U64 first = Arity*idx + 1;
+        if (first >= count) break;
+
+        U64 last = min(first + Arity, count);
+        U64 best = first;
+        for (U64 c = first + 1; c < last; ++c) if (heap_less(h, &h->nodes.data[c].val, &h->nodes.data[best].val)) best = c;
+
+        if (! heap_less(h, &h->nodes.data[best].val, &node.val)) break;
+        heap_place(h, idx, h->nodes.data[best]);
+        idx = best;
+    }
+
+    heap_place(h, idx, node);
+}
+
+template <typename T, typename Cmp, U64 Arity>
+Void heap_init (Heap<T, Cmp, Arity> *h, Mem *mem) {
+    array_init(&h->nodes, mem);
+    array_init(&h->positions, mem);
+    array_init(&h->free_handles, mem);
+}
+
+template <typename T, typename Cmp = HeapCmp, U64 Arity = 4>
+Heap<T, Cmp, Arity> heap_new (Mem *mem) {
+    Heap<T, Cmp, Arity> h;
+    heap_init(&h, mem);
+    return h;
+}
+
+// Builds the heap in O(n). The element at slice index i
+// gets the handle i.
+template <typename T, typename Cmp, U64 Arity>
+Void heap_init_from (Heap<T, Cmp, Arity> *h, Mem *mem, Slice<T> elems) {
+    heap_init(h, mem);
+    array_ensure_count(&h->nodes, elems.count, false);
+    array_ensure_count(&h->positions, elems.count, false);
+    for (U64 i = 0; i < elems.count; ++i) heap_place(h, i, HeapNode<T>{ elems.data[i], static_cast<HeapHandle>(i) });
+    if (elems.count > 1) for (U64 i = (elems.count - 2) / Arity + 1; i-- > 0;) heap_sift_down(h, i);
+}
+
+template <typename T, typename Cmp, U64 Arity>
+Void heap_free (Heap<T, Cmp, Arity> *h) {
+    array_free(&h->nodes);
+    array_free(&h->positions);
+    array_free(&h->free_handles);
+}
+
+// Invalidates all handles.
+template <typename T, typename Cmp, U64 Arity>
+Void heap_clear (Heap<T, Cmp, Arity> *h) {
+    h->nodes.count = 0;
+    h->positions.count = 0;
+    h->free_handles.count = 0;
+}
+
+template <typename T, typename Cmp, U64 Arity> U64  heap_count (Heap<T, Cmp, Arity> *h)                { return h->nodes.count; }
+template <typename T, typename Cmp, U64 Arity> Bool heap_has   (Heap<T, Cmp, Arity> *h, HeapHandle hd) { return (hd < h->positions.count) && (h->positions.data[hd] != HEAP_NIL_POS); }
+template <typename T, typename Cmp, U64 Arity> T   *heap_ref   (Heap<T, Cmp, Arity> *h, HeapHandle hd) { assert_always(heap_has(h, hd)); return &h->nodes.data[h->positions.data[hd]].val; }
+template <typename T, typename Cmp, U64 Arity> T    heap_get   (Heap<T, Cmp, Arity> *h, HeapHandle hd) { return *heap_ref(h, hd); }
+template <typename T, typename Cmp, U64 Arity> T    heap_peek  (Heap<T, Cmp, Arity> *h)                { return array_ref(&h->nodes, 0)->val; }
+
+template <typename T, typename Cmp, U64 Arity>
+HeapHandle heap_push (Heap<T, Cmp, Arity> *h, T val) {
+    HeapHandle handle;
+
+    if (h->free_handles.count) {
+        handle = array_pop(&h->free_handles);
+    } else {
+        assert_always(h->positions.count < HEAP_NIL_POS);
+        handle = h->positions.count;
+        array_push(&h->positions, HEAP_NIL_POS);
+    }
+
+    array_push(&h->nodes, HeapNode<T>{ val, handle });
+    heap_sift_up(h, h->nodes.count - 1);
+    return handle;
+}
+
+// Removes the element with the given handle.
+template <typename T, typename Cmp, U64 Arity>
+T heap_remove (Heap<T, Cmp, Arity> *h, HeapHandle hd) {
+    assert_always(heap_has(h, hd));
+    U64 idx = h->positions.data[hd];
+    T r = h->nodes.data[idx].val;
+
+    h->positions.data[hd] = HEAP_NIL_POS;
+    array_push(&h->free_handles, hd);
+
+    HeapNode<T> last = array_pop(&h->nodes);
+
+    if (idx < h->nodes.count) {
+        heap_place(h, idx, last);
+        if ((idx > 0) && heap_less(h, &last.val, &h->nodes.data[(idx - 1) / Arity].val)) heap_sift_up(h, idx);
+        else                                                                           heap_sift_down(h, idx);
+    }
+
+    return r;
+}
+
+template <typename T, typename Cmp, U64 Arity>
+T heap_pop (Heap<T, Cmp, Arity> *h) {
+    return heap_remove(h, array_ref(&h->nodes, 0)->handle);
+}
+
+// Changes the priority of an element. Works for both
+// decreasing and increasing the key.
+template <typename T, typename Cmp, U64 Arity>
+Void heap_update (Heap<T, Cmp, Arity> *h, HeapHandle hd, T val) {
+    T *ref = heap_ref(h, hd);
+    Bool up = heap_less(h, &val, ref);
+    *ref = val;
+    if (up) heap_sift_up(h, h->positions.data[hd]);
+    else    heap_sift_down(h, h->positions.data[hd]);
+}
+
+// Pops up to k elements into out in priority order.
+template <typename T, typename Cmp, U64 Arity>
+Void heap_pop_k (Heap<T, Cmp, Arity> *h, U64 k, Array<T> *out) {
+    while (k-- && h->nodes.count) array_push(out, heap_pop(h));
+}
+
+// Appends the k elements of the slice with the highest priority
+// (smallest according to Cmp) to out in priority order. Uses an
+// inverted heap of size k, so it's O(n log k) and only needs
+// O(k) memory.
+template <typename T, typename Cmp = HeapCmp, U64 Arity = 4>
+Void heap_top_k (Slice<T> elems, U64 k, Array<T> *out) {
+    if (k == 0) return;
+
+    tmem_new(tm);
+    Auto h = heap_new<T, HeapCmpReverse<Cmp>, Arity>(tm);
+
+    for (U64 i = 0; i < elems.count; ++i) {
+        T *e = &elems.data[i];
+
+        if (h.nodes.count < k) {
+            heap_push(&h, *e);
+        } else if (Cmp{}(e, &h.nodes.data[0].val) < 0) {
+            h.nodes.data[0].val = *e;
+            heap_sift_down(&h, 0);
+        }
+    }
+
+    U64 start = out->count;
+    heap_pop_k(&h, k, out);
+    for (U64 i = start, j = out->count; i + 1 < j; ++i, --j) swap(out->data[i], out->data[j - 1]);
+}
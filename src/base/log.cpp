@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include "base/log.h"
 #include "base/map.h"
+#include "base/phash.h"
+#include "base/seg_array.h"
 
 // =============================================================================
 // Stack Trace:
@@ -80,7 +82,8 @@ tls Log *log_data;
 
 assert_static(LOG_PLAIN == 0);
 
-CString log_tag_str [LOG_TAG_COUNT] = {
+// Constexpr so that log_tag_phash can be built from it.
+constexpr CString log_tag_str [LOG_TAG_COUNT] = {
     #define X(_, __, STR) STR,
         EACH_LOG_MSG(X)
     #undef X
@@ -92,6 +95,14 @@ CString log_tag_ansi [LOG_TAG_COUNT] = {
     #undef X
 };
 
+phash_def(log_tag_phash, log_tag_str);
+
+// Returns LOG_TAG_COUNT if the string is not a tag name.
+LogMsgTag log_tag_from_str (String s) {
+    U64 idx = phash_find(&log_tag_phash, s);
+    return (idx == ARRAY_NIL_IDX) ? LOG_TAG_COUNT : static_cast<LogMsgTag>(idx);
+}
+
 Void log_setup (Mem *mem, U64 min_block_size) {
     Arena *arena    = arena_new(mem, min_block_size);
     log_data        = mem_new(arena, Log);
@@ -208,7 +219,7 @@ struct Line {
     String content;
     Bool has_marks;
     Bool ends_with_ellipsis;
-    Array<LineSegment> segments;
+    SmallArray<LineSegment, 4> segments;
 };
 
 // Array of non-overlapping SrcPos in the same Src.
@@ -221,13 +232,13 @@ struct Src {
     String header;
     String content;
     Bool has_eol_mark;
-    Array<PosGroup*> groups;
+    SegArray<PosGroup> groups;
 };
 
 struct SrcLog {
     Mem *mem;
     SrcLogConfig config;
-    Array<Line*> lines;
+    SegArray<Line> lines;
     Map<SrcId, Src*> sources;
 };
 
@@ -275,7 +286,7 @@ SrcLog *slog_new (Mem *mem, SrcLogConfig *config) {
     SrcLog *log = mem_new(mem, SrcLog);
     log->mem    = mem;
     log->config = *config;
-    array_init(&log->lines, mem);
+    seg_array_init(&log->lines, mem);
     map_init(&log->sources, mem, 0);
     return log;
 }
@@ -285,20 +296,25 @@ Void slog_add_src (SrcLog *log, SrcId id, String header, String content) {
         Src *src = mem_new(log->mem, Src);
         src->header = header;
         src->content = content;
-        array_init(&src->groups, log->mem);
+        seg_array_init(&src->groups, log->mem);
         map_add(&log->sources, id, src);
     }
 }
 
 static Line *add_line (SrcLog *log, LineIter *lit) {
-    Line *line = array_try_get_last(&log->lines);
+    Line *line = seg_array_try_ref_last(&log->lines);
 
     if (!line || line->num != lit->line_num) {
-        line = mem_new(log->mem, Line);
+        // Slots are reused across parse_lines() calls, so we
+        // keep the segments array of the previous occupant.
+        // It has to stay in place since it's a SmallArray.
+        line = seg_array_push_slot(&log->lines);
         line->num = lit->line_num;
         line->content = lit->line;
-        array_init(&line->segments, log->mem);
-        array_push(&log->lines, line);
+        line->has_marks = false;
+        line->ends_with_ellipsis = false;
+        if (line->segments.mem) line->segments.count = 0;
+        else                    array_init(&line->segments, log->mem);
     }
 
     return line;
@@ -312,7 +328,7 @@ static Void add_segment (SrcPos pos, Line *line, U64 offset, U64 count) {
 }
 
 static Void parse_lines (SrcLog *log, Src *src, PosGroup *group) {
-    log->lines.count = 0;
+    seg_array_clear(&log->lines);
 
     SrcPos first_pos = array_get(&group->positions, 0);
     LineIter lit = line_iter_new(src->content, first_pos);
@@ -372,7 +388,7 @@ static Void parse_lines (SrcLog *log, Src *src, PosGroup *group) {
         add_line(log, &lit);
     }
 
-    array_iter (line, &log->lines) {
+    seg_array_iter_ptr (line, &log->lines) {
         if (line->segments.count == 0) {
             add_segment((SrcPos){}, line, 0, line->content.count);
         } else {
@@ -392,7 +408,7 @@ Void slog_add_pos (SrcLog *log, SrcId id, SrcPos new_pos) {
     assert_dbg(new_pos.offset <= src->content.count);
     assert_dbg(new_pos.length > 0 || new_pos.offset == src->content.count);
 
-    array_iter (group, &src->groups) {
+    seg_array_iter_ptr (group, &src->groups) {
         array_iter (old_pos, &group->positions) {
             U64 old_pos_end = old_pos.offset + old_pos.length - 1;
             if (old_pos_end < new_pos.offset) continue;
@@ -406,10 +422,9 @@ Void slog_add_pos (SrcLog *log, SrcId id, SrcPos new_pos) {
         continue_outer:;
     }
 
-    PosGroup *group = mem_new(log->mem, PosGroup);
+    PosGroup *group = seg_array_push_slot(&src->groups);
     array_init(&group->positions, log->mem);
     array_push(&group->positions, new_pos);
-    array_push(&src->groups, group);
 }
 
 Void slog_flush (SrcLog *log, AString *astr) {
@@ -419,12 +434,12 @@ Void slog_flush (SrcLog *log, AString *astr) {
 
         astr_push_fmt(astr, "%*s%sFILE" TERM_END ": %.*s\n\n", static_cast<Int>(log->config.left_margin), "", log->config.marked_text_ansi, STR(src->header));
 
-        array_iter (group, &src->groups) {
+        seg_array_iter_ptr (group, &src->groups) {
             parse_lines(log, src, group);
 
-            U64 left_margin = log->config.left_margin + count_digits(array_get_last(&log->lines)->num);
+            U64 left_margin = log->config.left_margin + count_digits(seg_array_ref_last(&log->lines)->num);
 
-            array_iter (line, &log->lines) {
+            seg_array_iter_ptr (line, &log->lines) {
                 astr_push_fmt(astr, "%s%*lu | " TERM_END, log->config.normal_text_ansi, static_cast<Int>(left_margin), line->num);
 
                 array_iter_ptr (seg, &line->segments) {
@@ -440,7 +455,7 @@ Void slog_flush (SrcLog *log, AString *astr) {
                     astr_push_fmt(astr, "%s%*s | %s", log->config.normal_text_ansi, static_cast<Int>(left_margin), " ", log->config.marked_text_ansi);
                     array_iter_ptr (seg, &line->segments) astr_push_bytes(astr, (seg->pos.length ? '^' : ' '), seg->content.count);
 
-                    if (src->has_eol_mark && ARRAY_ITER_DONE) {
+                    if (src->has_eol_mark && SEG_ARRAY_ITER_DONE) {
                         if (no_newline) astr_push_byte(astr, '^');
                         else            array_set_last(astr, '^');
                     }
@@ -451,7 +466,7 @@ Void slog_flush (SrcLog *log, AString *astr) {
                 if (line->ends_with_ellipsis) astr_push_fmt(astr, "%s%*s..." TERM_END "\n", log->config.normal_text_ansi, static_cast<Int>(log->config.left_margin), "");
             }
 
-            if (! ARRAY_ITER_DONE) astr_push_cstr(astr, TERM_END "\n");
+            if (! SEG_ARRAY_ITER_DONE) astr_push_cstr(astr, TERM_END "\n");
         }
     }
 }
@@ -107,9 +107,9 @@ struct Log {
     AString *open_msg_data;
 };
 
-extern tls Log *log_data;
-extern CString  log_tag_str  [LOG_TAG_COUNT];
-extern CString  log_tag_ansi [LOG_TAG_COUNT];
+extern tls Log       *log_data;
+extern const CString log_tag_str  [LOG_TAG_COUNT];
+extern CString       log_tag_ansi [LOG_TAG_COUNT];
 
 #define log_scope(N, F)\
     LogScope *N = log_scope_start(F);\
@@ -119,6 +119,7 @@ extern CString  log_tag_ansi [LOG_TAG_COUNT];
     AString  *N = log_msg_start(T, U, I);\
     defer { log_msg_end(); };
 
+LogMsgTag log_tag_from_str  (String);
 Void      log_setup         (Mem *, U64);
 LogScope *log_scope_start   (Bool);
 Void      log_scope_end     ();
@@ -21,8 +21,12 @@
 // named "hash" and "compare" which will be used by the
 // init code, or simply set the map->hash/compare fields
 // manually after initialization.
+//
+// Lookups that reuse a key across maps can compute the hash
+// once with map_hash() and pass it to map_get_hashed() and
+// map_add_hashed(). Bulk lookups should use map_get_many().
 // =============================================================================
-#include "base/core.h"
+#include "base/array.h"
 
 template <typename Key>
 using MapHashFn = U64 (*)(Key);
@@ -120,17 +124,23 @@ Void map_clear (Map<Key, Val> *map) {
     map->count = 0;
 }
 
+// Returns the hash as stored in MapEntry.hash. It can be passed
+// to the *_hashed functions when looking up the same key in many
+// maps that share the same hash function.
+template <typename Key, typename Val>
+U64 map_hash (Map<Key, Val> *map, Key key) {
+    return max(map->hash(key), MAP_HASH_OF_FILLED_ENTRY);
+}
+
 template <typename Key, typename Val>
 Val map_get_assert (Map<Key, Val> *map, Key key) {
-    U64 hash   = max(map->hash(key), MAP_HASH_OF_FILLED_ENTRY);
-    Auto entry = map_probe(map, false, key, hash);
+    Auto entry = map_probe(map, false, key, map_hash(map, key));
     assert_always(entry->hash >= MAP_HASH_OF_FILLED_ENTRY);
     return entry->val;
 }
 
 template <typename Key, typename Val>
-Bool map_get (Map<Key, Val> *map, Key key, Val *out_val) {
-    U64 hash   = max(map->hash(key), MAP_HASH_OF_FILLED_ENTRY);
+Bool map_get_hashed (Map<Key, Val> *map, Key key, U64 hash, Val *out_val) {
     Auto entry = map_probe(map, false, key, hash);
     if (entry->hash >= MAP_HASH_OF_FILLED_ENTRY) {
         if (out_val) *out_val = entry->val;
@@ -139,18 +149,56 @@ Bool map_get (Map<Key, Val> *map, Key key, Val *out_val) {
     return false;
 }
 
+template <typename Key, typename Val>
+Bool map_get (Map<Key, Val> *map, Key key, Val *out_val) {
+    return map_get_hashed(map, key, map_hash(map, key), out_val);
+}
+
 template <typename Key, typename Val>
 Val map_get_ptr (Map<Key, Val> *map, Key key) {
-    U64 hash   = max(map->hash(key), MAP_HASH_OF_FILLED_ENTRY);
-    Auto entry = map_probe(map, false, key, hash);
+    Auto entry = map_probe(map, false, key, map_hash(map, key));
     return (entry->hash < MAP_HASH_OF_FILLED_ENTRY) ? 0 : entry->val;
 }
 
+// Looks up keys.count keys at once. The hashes of a batch
+// are computed first and the home buckets are prefetched
+// before any probing is done, so the cache misses overlap
+// instead of each lookup waiting on the previous one.
+//
+// The out_vals and out_found arrays (the latter can be 0)
+// must have room for keys.count elements. If a key is not
+// found the corresponding out_vals slot is left untouched.
+// Returns the number of keys found.
+template <typename Key, typename Val>
+U64 map_get_many (Map<Key, Val> *map, Slice<Key> keys, Val *out_vals, Bool *out_found) {
+    const U64 BATCH = 16;
+    U64 hashes[BATCH];
+    U64 mask   = map->capacity - 1;
+    U64 result = 0;
+
+    for (U64 start = 0; start < keys.count; start += BATCH) {
+        U64 n = min(BATCH, keys.count - start);
+
+        for (U64 i = 0; i < n; ++i) {
+            hashes[i] = map_hash(map, keys.data[start + i]);
+            __builtin_prefetch(&map->entries[hashes[i] & mask]);
+        }
+
+        for (U64 i = 0; i < n; ++i) {
+            Bool found = map_get_hashed(map, keys.data[start + i], hashes[i], &out_vals[start + i]);
+            if (out_found) out_found[start + i] = found;
+            result += found;
+        }
+    }
+
+    return result;
+}
+
 template <typename Key, typename Val>
-Bool map_add (Map<Key, Val> *map, Key key, Val val) {
+Bool map_add_hashed (Map<Key, Val> *map, Key key, U64 hash, Val val) {
+    assert_dbg(hash >= MAP_HASH_OF_FILLED_ENTRY);
     map_maybe_grow(map);
 
-    U64 hash   = max(map->hash(key), MAP_HASH_OF_FILLED_ENTRY);
     Auto entry = map_probe(map, false, key, hash);
     Bool found = (entry->hash >= MAP_HASH_OF_FILLED_ENTRY);
 
@@ -164,10 +212,14 @@ Bool map_add (Map<Key, Val> *map, Key key, Val val) {
     return found;
 }
 
+template <typename Key, typename Val>
+Bool map_add (Map<Key, Val> *map, Key key, Val val) {
+    return map_add_hashed(map, key, map_hash(map, key), val);
+}
+
 template <typename Key, typename Val>
 Bool map_remove (Map<Key, Val> *map, Key key) {
-    U64 hash   = max(map->hash(key), MAP_HASH_OF_FILLED_ENTRY);
-    Auto entry = map_probe(map, false, key, hash);
+    Auto entry = map_probe(map, false, key, map_hash(map, key));
     Bool found = (entry->hash >= MAP_HASH_OF_FILLED_ENTRY);
 
     if (found) {
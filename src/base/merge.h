@@ -0,0 +1,255 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// Merging of sorted runs and a multithreaded merge sort.
+//
+// The MergeTree is a tournament tree of losers over k sorted
+// runs. Each call to merge_tree_next() yields the smallest head
+// among the runs with log2(k) comparisons, so runs that are
+// already sorted (per file logs, ...) can be merged without
+// concatenating and re-sorting them. On ties the run with the
+// lower index wins, which makes the merge stable.
+//
+//     Slice<Entry> runs[] = { slice(&a), slice(&b), slice(&c) };
+//     Auto tree = merge_tree_new(mem, Slice<Slice<Entry>>{ runs, 3 }, cmp);
+//     Entry e;
+//     while (merge_tree_next(&tree, &e)) ...
+//
+// The sort_parallel() function sorts equal chunks with sort_pdq
+// on separate threads and then merges pairs of runs in rounds.
+// Each pairwise merge is split among the threads along its merge
+// path, so every round uses all threads until the last one.
+//
+// The comparators use the c_compare convention as in sort.h,
+// and for sort_parallel they get called from several threads.
+// Those threads don't have TMem set up.
+//
+// =============================================================================
+#include "base/array.h"
+#include "os/info.h"
+#include "os/thread.h"
+
+// Below this count sort_parallel just calls sort_pdq.
+const U64 SORT_PARALLEL_MIN_COUNT = 1 << 16;
+const U64 SORT_PARALLEL_MAX_THREADS = 64;
+
+template <typename T, typename F>
+struct MergeTree {
+    Mem *mem;
+    F cmp;
+    Slice<T> *runs; // Advanced as elements get consumed.
+    U64 run_count;
+    U64 leaf_count; // Power of 2 >= run_count.
+    U32 *losers;    // losers[0] is the overall winner.
+};
+
+// =============================================================================
+// MergeTree:
+// =============================================================================
+// Exhausted runs compare greater than anything.
+template <typename T, typename F>
+Bool merge_tree_less (MergeTree<T, F> *t, U32 a, U32 b) {
+    if (a >= t->run_count || t->runs[a].count == 0) return false;
+    if (b >= t->run_count || t->runs[b].count == 0) return true;
+    Int c = t->cmp(t->runs[a].data, t->runs[b].data);
+    return (c < 0) || (c == 0 && a < b);
+}
+
+template <typename T, typename F>
+Void merge_tree_init (MergeTree<T, F> *t, Mem *mem, Slice<Slice<T>> runs, const F &cmp) {
+    U64 k = max(runs.count, 1lu);
+    *t = { .mem=mem, .cmp=cmp, .run_count=runs.count, .leaf_count=next_pow2(k) };
+
+    t->runs   = mem_alloc(mem, Slice<T>, .size=(k * sizeof(Slice<T>)), .align=alignof(Slice<T>));
+    t->losers = mem_alloc(mem, U32, .size=(t->leaf_count * sizeof(U32)), .align=alignof(U32));
+    if (runs.count) memcpy(t->runs, runs.data, runs.count * sizeof(Slice<T>));
+
+    // Play the initial tournament bottom up. The winners of
+    // the matches are only needed temporarily.
+    tmem_new(tm);
+    U64 n = t->leaf_count;
+    U32 *winners = mem_alloc(tm, U32, .size=(2 * n * sizeof(U32)), .align=alignof(U32));
+    for (U64 i = 0; i < n; ++i) winners[n + i] = i;
+
+    for (U64 i = n - 1; i > 0; --i) {
+        U32 a = winners[2*i];
+        U32 b = winners[2*i + 1];
+        Bool b_wins  = merge_tree_less(t, b, a);
+        winners[i]   = b_wins ? b : a;
+        t->losers[i] = b_wins ? a : b;
+    }
+
+    t->losers[0] = (n > 1) ? winners[1] : 0;
+}
+
+template <typename T, typename F>
+MergeTree<T, F> merge_tree_new (Mem *mem, Slice<Slice<T>> runs, const F &cmp) {
+    MergeTree<T, F> t;
+    merge_tree_init(&t, mem, runs, cmp);
+    return t;
+}
+
+template <typename T, typename F>
+Void merge_tree_free (MergeTree<T, F> *t) {
+    mem_free(t->mem, .old_ptr=t->runs, .old_size=(max(t->run_count, 1lu) * sizeof(Slice<T>)));
+    mem_free(t->mem, .old_ptr=t->losers, .old_size=(t->leaf_count * sizeof(U32)));
+}
+
+// Returns false once all runs are exhausted.
+template <typename T, typename F>
+Bool merge_tree_next (MergeTree<T, F> *t, T *out) {
+    U32 winner = t->losers[0];
+    if (winner >= t->run_count || t->runs[winner].count == 0) return false;
+
+    Slice<T> *run = &t->runs[winner];
+    *out = run->data[0];
+    run->data++;
+    run->count--;
+
+    // Replay the matches on the path from the leaf to the root.
+    for (U64 i = (t->leaf_count + winner) / 2; i > 0; i /= 2) {
+        if (merge_tree_less(t, t->losers[i], winner)) swap(winner, t->losers[i]);
+    }
+
+    t->losers[0] = winner;
+    return true;
+}
+
+// Merges all runs into out which must have room for the sum
+// of the run counts. Returns the number of elements written.
+template <typename T, typename F>
+U64 merge_runs (Slice<Slice<T>> runs, T *out, const F &cmp) {
+    tmem_new(tm);
+    Auto t = merge_tree_new(tm, runs, cmp);
+    U64 n = 0;
+    while (merge_tree_next(&t, &out[n])) n++;
+    return n;
+}
+
+// =============================================================================
+// Two-way merge:
+// =============================================================================
+// Returns how many elements of a come before the output
+// position d in the stable merge of a and b. The rest (d - i)
+// come from b.
+template <typename T, typename F>
+U64 merge_path_split (Slice<T> a, Slice<T> b, U64 d, const F &cmp) {
+    U64 lo = (d > b.count) ? d - b.count : 0;
+    U64 hi = min(d, a.count);
+
+    while (lo < hi) {
+        U64 i = (lo + hi) / 2;
+        U64 j = d - i;
+        if (cmp(&a.data[i], &b.data[j - 1]) <= 0) lo = i + 1;
+        else                                      hi = i;
+    }
+
+    return lo;
+}
+
+// Stable; on ties elements from a come first.
+template <typename T, typename F>
+Void merge_two (Slice<T> a, Slice<T> b, T *out, const F &cmp) {
+    U64 i = 0, j = 0;
+
+    while (i < a.count && j < b.count) {
+        Bool take_b = cmp(&b.data[j], &a.data[i]) < 0;
+        *out++ = take_b ? b.data[j++] : a.data[i++];
+    }
+
+    if (i < a.count) memcpy(out, a.data + i, (a.count - i) * sizeof(T));
+    if (j < b.count) memcpy(out, b.data + j, (b.count - j) * sizeof(T));
+}
+
+// =============================================================================
+// Parallel sort:
+// =============================================================================
+template <typename F>
+struct ParallelTask {
+    const F *fn;
+    U64 idx;
+};
+
+// Calls fn(i) for i in [0, n) with each call on its own
+// thread. The call for 0 runs on the calling thread.
+template <typename F>
+Void parallel_for (U64 n, const F &fn) {
+    assert_always(n <= SORT_PARALLEL_MAX_THREADS);
+    OsThread threads[SORT_PARALLEL_MAX_THREADS];
+    ParallelTask<F> tasks[SORT_PARALLEL_MAX_THREADS];
+
+    for (U64 i = 1; i < n; ++i) {
+        tasks[i]   = { &fn, i };
+        threads[i] = os_thread_spawn([](Void *arg){ Auto task = static_cast<ParallelTask<F>*>(arg); (*task->fn)(task->idx); }, &tasks[i]);
+    }
+
+    if (n) fn(0);
+    for (U64 i = 1; i < n; ++i) os_thread_join(threads[i]);
+}
+
+// If thread_count is 0 the number of processors is used.
+template <typename T, typename F>
+Void sort_parallel (T *data, U64 count, const F &cmp, U64 thread_count=0) {
+    U64 p = thread_count ? thread_count : os_get_proc_count();
+    p = min(p, SORT_PARALLEL_MAX_THREADS);
+
+    if (p < 2 || count < SORT_PARALLEL_MIN_COUNT) {
+        sort_pdq(data, count, cmp);
+        return;
+    }
+
+    // 1. Sort p chunks in parallel. Run r is [bounds[r], bounds[r+1]).
+    U64 bounds[SORT_PARALLEL_MAX_THREADS + 1];
+    for (U64 r = 0; r <= p; ++r) bounds[r] = count * r / p;
+    parallel_for(p, [&](U64 r){ sort_pdq(data + bounds[r], bounds[r + 1] - bounds[r], cmp); });
+
+    // 2. Merge pairs of runs in rounds ping-ponging between
+    //    the data and a buffer. Each pair gets split into
+    //    pieces along its merge path so that all threads work.
+    tmem_new(tm);
+    T *buf = mem_alloc(tm, T, .size=(count * sizeof(T)), .align=alignof(T));
+    T *src = data;
+    T *dst = buf;
+    U64 runs = p;
+
+    while (runs > 1) {
+        U64 pairs  = runs / 2;
+        U64 pieces = max(p / pairs, 1lu);
+
+        parallel_for(pairs * pieces, [&](U64 task){
+            U64 pair  = task / pieces;
+            U64 piece = task % pieces;
+            U64 start = bounds[2*pair];
+            U64 mid   = bounds[2*pair + 1];
+            U64 end   = bounds[2*pair + 2];
+
+            Slice<T> a = { src + start, mid - start };
+            Slice<T> b = { src + mid, end - mid };
+            U64 n  = end - start;
+            U64 d0 = n * piece / pieces;
+            U64 d1 = n * (piece + 1) / pieces;
+            U64 i0 = merge_path_split(a, b, d0, cmp);
+            U64 i1 = merge_path_split(a, b, d1, cmp);
+
+            merge_two(Slice<T>{ a.data + i0, i1 - i0 }, Slice<T>{ b.data + (d0 - i0), (d1 - i1) - (d0 - i0) }, dst + start + d0, cmp);
+        });
+
+        // An odd run at the end is carried over unmerged.
+        if (runs % 2) memcpy(dst + bounds[runs - 1], src + bounds[runs - 1], (bounds[runs] - bounds[runs - 1]) * sizeof(T));
+
+        for (U64 r = 0; r <= pairs; ++r) bounds[r] = bounds[2*r];
+        if (runs % 2) bounds[pairs + 1] = bounds[runs];
+        runs = (runs + 1) / 2;
+        swap(src, dst);
+    }
+
+    if (src != data) memcpy(data, src, count * sizeof(T));
+}
+
+template <typename T, typename F>
+Void array_sort_parallel (T *a, const F &cmp) {
+    sort_parallel(a->data, a->count, cmp);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A minimal perfect hash table over a fixed set of strings
+// that is built at compile time. It is meant for keyword sets
+// (config keys, tag names, ...) that would otherwise go into
+// a runtime Map.
+//
+// The construction uses the hash and displace method. Keys are
+// first distributed into N buckets by their hash, and then for
+// each bucket (biggest first) we search for a displacement that
+// sends all its keys into free slots of the N slot table.
+//
+// A lookup is one pass of phash_str() over the key, one mixing
+// step with the bucket displacement and one string comparison.
+// No allocation is performed.
+//
+// Construction fails (PHash.ok is false) if the key list has
+// duplicates or if no displacement is found. Use phash_def()
+// which turns that into a compile error.
+//
+// Usage example:
+// --------------
+//
+//     constexpr CString keys[] = { "low", "medium", "high" };
+//     phash_def(priorities, keys);
+//
+//     U64 idx = phash_find(&priorities, str("medium")); // 1
+//     U64 nil = phash_find(&priorities, str("urgent")); // ARRAY_NIL_IDX
+//
+// =============================================================================
+#include "base/string.h"
+
+template <U64 N>
+struct PHash {
+    Bool ok;
+    CString keys[N];    // In slot order.
+    U64 key_counts[N];  // In slot order.
+    U64 key_idx[N];     // Map from slot to index in the original key list.
+    U64 disp[N];        // Map from bucket to displacement.
+};
+
+#define phash_def(NAME, KEYS)\
+    constexpr Auto NAME = phash_new(KEYS);\
+    assert_static(NAME.ok, "Perfect hash construction failed (duplicate keys?).");
+
+constexpr U64 PHASH_MAX_DISPLACEMENT = 1 << 16;
+
+// Fnv64a. Keyword sets are short so a byte loop is
+// fine, and unlike str_hash() this works in constexpr.
+constexpr U64 phash_str (const Char *data, U64 count) {
+    U64 h = 0xcbf29ce484222325ull;
+    for (U64 i = 0; i < count; ++i) h = (h ^ static_cast<U8>(data[i])) * 0x100000001b3ull;
+    return h;
+}
+
+constexpr U64 phash_slot (U64 hash, U64 disp, U64 n) {
+    U64 x = hash ^ (disp * 0x9e3779b97f4a7c15ull);
+    x ^= x >> 32;
+    x *= 0xd6e8feb86659fd93ull;
+    x ^= x >> 32;
+    return x % n;
+}
+
+constexpr U64 phash_bucket (U64 hash, U64 n) {
+    return (hash >> 32) % n;
+}
+
+constexpr U64 phash_cstr_count (CString s) {
+    U64 n = 0;
+    while (s[n]) n++;
+    return n;
+}
+
+template <U64 N>
+constexpr PHash<N> phash_new (const CString (&keys)[N]) {
+    assert_static(N > 0);
+
+    PHash<N> r = {};
+    U64 hashes[N] = {};
+    U64 counts[N] = {};
+    U64 bucket_sizes[N] = {};
+    U64 bucket_order[N] = {};
+    Bool taken[N] = {};
+
+    for (U64 i = 0; i < N; ++i) {
+        counts[i] = phash_cstr_count(keys[i]);
+        hashes[i] = phash_str(keys[i], counts[i]);
+        bucket_sizes[phash_bucket(hashes[i], N)]++;
+        bucket_order[i] = i;
+
+        for (U64 j = 0; j < i; ++j) {
+            if (counts[i] != counts[j]) continue;
+            Bool same = true;
+            for (U64 k = 0; k < counts[i]; ++k) if (keys[i][k] != keys[j][k]) { same = false; break; }
+            if (same) return r;
+        }
+    }
+
+    // Biggest buckets first since they are the hardest to place.
+    for (U64 i = 0; i < N; ++i) {
+        for (U64 j = i + 1; j < N; ++j) {
+            if (bucket_sizes[bucket_order[j]] > bucket_sizes[bucket_order[i]]) swap(bucket_order[i], bucket_order[j]);
+        }
+    }
+
+    for (U64 b : bucket_order) {
+        if (bucket_sizes[b] == 0) break;
+
+        U64 disp = 0;
+        U64 slots[N] = {};
+
+        for (; disp < PHASH_MAX_DISPLACEMENT; ++disp) {
+            U64 placed = 0;
+
+            for (U64 i = 0; i < N; ++i) {
+                if (phash_bucket(hashes[i], N) != b) continue;
+                U64 slot = phash_slot(hashes[i], disp, N);
+                if (taken[slot]) break;
+                Bool clash = false;
+                for (U64 j = 0; j < placed; ++j) if (slots[j] == slot) { clash = true; break; }
+                if (clash) break;
+                slots[placed++] = slot;
+            }
+
+            if (placed == bucket_sizes[b]) break;
+        }
+
+        if (disp == PHASH_MAX_DISPLACEMENT) return r;
+        r.disp[b] = disp;
+
+        for (U64 i = 0; i < N; ++i) {
+            if (phash_bucket(hashes[i], N) != b) continue;
+            U64 slot = phash_slot(hashes[i], disp, N);
+            taken[slot]        = true;
+            r.keys[slot]       = keys[i];
+            r.key_counts[slot] = counts[i];
+            r.key_idx[slot]    = i;
+        }
+    }
+
+    r.ok = true;
+    return r;
+}
+
+// Returns the index of the key in the list given to phash_new
+// or ARRAY_NIL_IDX if the key is not in the set.
+template <U64 N>
+U64 phash_find (const PHash<N> *ph, String key) {
+    U64 hash = phash_str(key.data, key.count);
+    U64 slot = phash_slot(hash, ph->disp[phash_bucket(hash, N)], N);
+    if (ph->key_counts[slot] != key.count) return ARRAY_NIL_IDX;
+    if (key.count && memcmp(ph->keys[slot], key.data, key.count)) return ARRAY_NIL_IDX;
+    return ph->key_idx[slot];
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// Circular buffers with a power of 2 capacity:
+//
+//   - Ring<T> has a fixed capacity. When it's full a push either
+//     overwrites the oldest element or is rejected depending on
+//     the policy given at init. Good for histories and windows
+//     of recent items.
+//
+//   - Deque<T> grows as needed and supports pushing and popping
+//     at both ends in O(1).
+//
+// In both, index 0 refers to the front (oldest) element. The
+// contents can be viewed as 2 slices in order (the second one
+// is empty unless the elements wrap around the buffer end),
+// which is convenient for bulk copies or writev():
+//
+//     Auto s = ring_slices(&ring);
+//     memcpy(dst, s.first.data, s.first.count * sizeof(T));
+//     memcpy(dst + s.first.count, s.second.data, s.second.count * sizeof(T));
+//
+// These data structures are only suitable for POD types.
+//
+// Usage example:
+// --------------
+//
+//     Auto r = ring_new<U64>(mem, 64, RING_OVERWRITE);
+//     ring_push(&r, 42lu);
+//     U64 oldest = ring_pop(&r);
+//
+//     Auto d = deque_new<U64>(mem);
+//     deque_push_front(&d, 1lu);
+//     deque_push_back(&d, 2lu);
+//     U64 last = deque_pop_back(&d);
+//
+// =============================================================================
+#include "base/array.h"
+
+enum RingPolicy: U8 {
+    RING_OVERWRITE, // Drop the oldest element when full.
+    RING_REJECT,    // Fail the push when full.
+};
+
+template <typename T>
+struct RingSlices {
+    Slice<T> first;
+    Slice<T> second;
+};
+
+template <typename T>
+struct Ring {
+    T *data;
+    U64 head; // Buffer idx of the front element.
+    U64 count;
+    U64 capacity;
+    Mem *mem;
+    RingPolicy policy;
+};
+
+template <typename T>
+struct Deque {
+    T *data;
+    U64 head;
+    U64 count;
+    U64 capacity;
+    Mem *mem;
+};
+
+// =============================================================================
+// Shared:
+// =============================================================================
+// These work on both Ring and Deque.
+template <typename R> U64 ring_buf_idx (R *r, U64 i) { return (r->head + i) & (r->capacity - 1); }
+
+template <typename R>
+RingSlices<Elem(R)> ring_slices (R *r) {
+    U64 first = min(r->count, r->capacity - r->head);
+    return { .first={ .data=(r->data + r->head), .count=first }, .second={ .data=r->data, .count=(r->count - first) } };
+}
+
+template <typename R> Elem(R) *ring_ref      (R *r, U64 i) { assert_always(i < r->count); return &r->data[ring_buf_idx(r, i)]; }
+template <typename R> Elem(R)  ring_get      (R *r, U64 i) { return *ring_ref(r, i); }
+template <typename R> Elem(R) *ring_ref_last (R *r)        { return ring_ref(r, r->count - 1); }
+template <typename R> Void     ring_clear    (R *r)        { r->head = 0; r->count = 0; }
+
+// =============================================================================
+// Ring:
+// =============================================================================
+template <typename T>
+Void ring_init (Ring<T> *r, Mem *mem, U64 capacity, RingPolicy policy) {
+    assert_always(is_pow2(capacity));
+    *r = { .capacity=capacity, .mem=mem, .policy=policy };
+    r->data = mem_alloc(mem, T, .size=(capacity * sizeof(T)), .align=alignof(T));
+}
+
+template <typename T>
+Ring<T> ring_new (Mem *mem, U64 capacity, RingPolicy policy) {
+    Ring<T> r;
+    ring_init(&r, mem, capacity, policy);
+    return r;
+}
+
+template <typename T>
+Void ring_free (Ring<T> *r) {
+    mem_free(r->mem, .old_ptr=r->data, .old_size=(r->capacity * sizeof(T)));
+}
+
+// Returns false if the element was rejected.
+template <typename T>
+Bool ring_push (Ring<T> *r, T val) {
+    if (r->count == r->capacity) {
+        if (r->policy == RING_REJECT) return false;
+        r->data[r->head] = val;
+        r->head = ring_buf_idx(r, 1);
+        return true;
+    }
+
+    r->data[ring_buf_idx(r, r->count++)] = val;
+    return true;
+}
+
+// Removes the front (oldest) element.
+template <typename T>
+T ring_pop (Ring<T> *r) {
+    T val = *ring_ref(r, 0);
+    r->head = ring_buf_idx(r, 1);
+    r->count--;
+    return val;
+}
+
+// =============================================================================
+// Deque:
+// =============================================================================
+template <typename T>
+Void deque_init (Deque<T> *d, Mem *mem) {
+    *d = { .mem=mem };
+}
+
+template <typename T>
+Deque<T> deque_new (Mem *mem) {
+    Deque<T> d;
+    deque_init(&d, mem);
+    return d;
+}
+
+template <typename T>
+Void deque_free (Deque<T> *d) {
+    if (d->capacity) mem_free(d->mem, .old_ptr=d->data, .old_size=(d->capacity * sizeof(T)));
+}
+
+// Doubles the capacity. The elements that wrapped around
+// get moved right after the old end of the buffer.
+template <typename T>
+Void deque_grow (Deque<T> *d) {
+    U64 old_cap = d->capacity;
+    U64 new_cap = old_cap ? safe_mul(old_cap, 2lu) : 8;
+
+    d->data     = mem_grow(d->mem, T, .size=(new_cap * sizeof(T)), .old_ptr=d->data, .old_size=(old_cap * sizeof(T)));
+    d->capacity = new_cap;
+
+    if (d->head + d->count > old_cap) memcpy(d->data + old_cap, d->data, (d->head + d->count - old_cap) * sizeof(T));
+}
+
+template <typename T>
+Void deque_push_back (Deque<T> *d, T val) {
+    if (d->count == d->capacity) deque_grow(d);
+    d->data[ring_buf_idx(d, d->count++)] = val;
+}
+
+template <typename T>
+Void deque_push_front (Deque<T> *d, T val) {
+    if (d->count == d->capacity) deque_grow(d);
+    d->head = ring_buf_idx(d, d->capacity - 1);
+    d->count++;
+    d->data[d->head] = val;
+}
+
+template <typename T>
+T deque_pop_front (Deque<T> *d) {
+    T val = *ring_ref(d, 0);
+    d->head = ring_buf_idx(d, 1);
+    d->count--;
+    return val;
+}
+
+template <typename T>
+T deque_pop_back (Deque<T> *d) {
+    T val = *ring_ref_last(d);
+    d->count--;
+    return val;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A build-once, query-many search structure for sorted keys.
+//
+// The keys are copied into Eytzinger (BFS) order: the root of
+// an implicit binary search tree is at index 1 and the children
+// of node k are at 2k and 2k+1. The lower bound search is then
+// a branchless descent that always runs log2(n) steps, and the
+// nodes a few levels ahead can be prefetched since they are all
+// adjacent in memory.
+//
+// Queries return ranks, that is, indices into the sorted slice
+// the structure was built from. The caller can keep that slice
+// (or a parallel array of values) to map ranks to data.
+//
+// Keys are compared with operator<, so this is meant for scalar
+// keys like timestamps and ids.
+//
+// Usage example:
+// --------------
+//
+//     Auto s = search_array_new(mem, slice(&sorted_ids));
+//     U64 rank = search_array_find(&s, 42lu);
+//     if (rank != ARRAY_NIL_IDX) printf("%lu\n", array_get(&sorted_ids, rank));
+//
+// =============================================================================
+#include "base/array.h"
+
+// How many tree levels ahead to prefetch. The 2^N descendants
+// of a node at that depth are adjacent in memory, so with 8 byte
+// keys and N = 3 they span one cache line.
+const U64 SEARCH_ARRAY_PREFETCH_LEVELS = 3;
+
+template <typename T>
+struct SearchArray {
+    T *keys;    // In Eytzinger order, 1-indexed.
+    U64 *ranks; // ranks[k] = index of keys[k] in sorted order.
+    U64 count;
+    Mem *mem;
+};
+
+template <typename T>
+U64 search_array_fill (SearchArray<T> *s, Slice<T> sorted, U64 i, U64 k) {
+    if (k <= s->count) {
+        i = search_array_fill(s, sorted, i, 2*k);
+        s->keys[k]  = sorted.data[i];
+        s->ranks[k] = i++;
+        i = search_array_fill(s, sorted, i, 2*k + 1);
+    }
+
+    return i;
+}
+
+// The slice must be sorted in ascending order.
+template <typename T>
+Void search_array_init (SearchArray<T> *s, Mem *mem, Slice<T> sorted) {
+    *s = { .count=sorted.count, .mem=mem };
+    s->keys  = mem_alloc(mem, T, .size=((s->count + 1) * sizeof(T)), .align=64);
+    s->ranks = mem_alloc(mem, U64, .size=((s->count + 1) * sizeof(U64)), .align=alignof(U64));
+    s->keys[0]  = {};
+    s->ranks[0] = s->count;
+    search_array_fill(s, sorted, 0, 1);
+}
+
+template <typename T>
+SearchArray<T> search_array_new (Mem *mem, Slice<T> sorted) {
+    SearchArray<T> s;
+    search_array_init(&s, mem, sorted);
+    return s;
+}
+
+template <typename T>
+Void search_array_free (SearchArray<T> *s) {
+    mem_free(s->mem, .old_ptr=s->keys, .old_size=((s->count + 1) * sizeof(T)));
+    mem_free(s->mem, .old_ptr=s->ranks, .old_size=((s->count + 1) * sizeof(U64)));
+}
+
+// Returns the Eytzinger index of the first key that is not
+// less than the given one or 0 if there is no such key.
+template <typename T>
+U64 search_array_descend (SearchArray<T> *s, T key) {
+    U64 k = 1;
+
+    while (k <= s->count) {
+        __builtin_prefetch(s->keys + (k << SEARCH_ARRAY_PREFETCH_LEVELS));
+        k = 2*k + (s->keys[k] < key);
+    }
+
+    // The path went right at every level below the answer,
+    // so drop those trailing 1 bits plus the final left turn.
+    return k >> __builtin_ffsll(~k);
+}
+
+// Returns the rank of the first key that is not less than
+// the given one, or the key count if there is no such key.
+template <typename T>
+U64 search_array_lower_bound (SearchArray<T> *s, T key) {
+    return s->ranks[search_array_descend(s, key)];
+}
+
+// Returns the rank of a key equal to the given one or ARRAY_NIL_IDX.
+template <typename T>
+U64 search_array_find (SearchArray<T> *s, T key) {
+    U64 k = search_array_descend(s, key);
+    return (k && !(key < s->keys[k])) ? s->ranks[k] : ARRAY_NIL_IDX;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A dynamic array stored in segments whose sizes are powers
+// of 2. Segment k holds SEG_ARRAY_BASE << k elements, so the
+// segment of an index is found with a single clz and indexing
+// stays O(1).
+//
+// Growing allocates a new segment and never moves existing
+// elements, so pointers to elements remain valid until the
+// array is freed. This makes it suitable for holding objects
+// inline that would otherwise be allocated one by one and
+// referenced through an Array<T*>.
+//
+// This data structure is only suitable for POD types.
+//
+// Usage example:
+// --------------
+//
+//     Auto a = seg_array_new<Foo>(mem);
+//     Foo *foo = seg_array_push_slot(&a); // Stays valid.
+//     seg_array_push(&a, Foo{});
+//     seg_array_iter_ptr (it, &a) printf("[%lu] = %p\n", SEG_ARRAY_IDX, it);
+//
+// =============================================================================
+#include "base/array.h"
+
+const U64 SEG_ARRAY_BASE_LOG2    = 4;
+const U64 SEG_ARRAY_BASE         = 1 << SEG_ARRAY_BASE_LOG2;
+const U64 SEG_ARRAY_MAX_SEGMENTS = 40;
+
+template <typename T>
+struct SegArray {
+    T *segments[SEG_ARRAY_MAX_SEGMENTS];
+    U64 segment_count;
+    U64 count;
+    U64 capacity;
+    Mem *mem;
+};
+
+#define seg_array_iter_ptr(X, A) let1(SEG_ARRAY, A) if (U64 SEG_ARRAY_IDX=0; true)\
+                                 for (Auto X = seg_array_try_ref(SEG_ARRAY, 0); X; X = seg_array_try_ref(SEG_ARRAY, ++SEG_ARRAY_IDX))
+
+#define SEG_ARRAY_ITER_DONE (SEG_ARRAY_IDX == (SEG_ARRAY->count - 1))
+
+template <typename T> U64 seg_array_segment_size (U64 k) { return SEG_ARRAY_BASE << k; }
+
+// No bounds checking.
+template <typename T>
+T *seg_array_slot (SegArray<T> *a, U64 idx) {
+    U64 j = idx + SEG_ARRAY_BASE;
+    U64 b = 63 - __builtin_clzll(j);
+    return &a->segments[b - SEG_ARRAY_BASE_LOG2][j - (1ull << b)];
+}
+
+template <typename T>
+Void seg_array_init (SegArray<T> *a, Mem *mem) {
+    *a = { .mem=mem };
+}
+
+template <typename T>
+SegArray<T> seg_array_new (Mem *mem) {
+    SegArray<T> a;
+    seg_array_init(&a, mem);
+    return a;
+}
+
+template <typename T>
+Void seg_array_free (SegArray<T> *a) {
+    for (U64 k = 0; k < a->segment_count; ++k) mem_free(a->mem, .old_ptr=a->segments[k], .old_size=(seg_array_segment_size<T>(k) * sizeof(T)));
+    seg_array_init(a, a->mem);
+}
+
+// Keeps the segments for reuse.
+template <typename T>
+Void seg_array_clear (SegArray<T> *a) {
+    a->count = 0;
+}
+
+template <typename T>
+Void seg_array_add_segment (SegArray<T> *a) {
+    assert_always(a->segment_count < SEG_ARRAY_MAX_SEGMENTS);
+    U64 n = seg_array_segment_size<T>(a->segment_count);
+    a->segments[a->segment_count++] = mem_alloc(a->mem, T, .zeroed=true, .size=(n * sizeof(T)), .align=alignof(T));
+    a->capacity += n;
+}
+
+template <typename T> Void seg_array_bounds_check (SegArray<T> *a, U64 i)      { assert_always(i < a->count); }
+template <typename T> T   *seg_array_ref          (SegArray<T> *a, U64 i)      { seg_array_bounds_check(a, i); return seg_array_slot(a, i); }
+template <typename T> T    seg_array_get          (SegArray<T> *a, U64 i)      { return *seg_array_ref(a, i); }
+template <typename T> T    seg_array_set          (SegArray<T> *a, U64 i, T v) { return *seg_array_ref(a, i) = v; }
+template <typename T> T   *seg_array_try_ref      (SegArray<T> *a, U64 i)      { return (i < a->count) ? seg_array_slot(a, i) : 0; }
+template <typename T> T   *seg_array_ref_last     (SegArray<T> *a)             { seg_array_bounds_check(a, 0); return seg_array_slot(a, a->count - 1); }
+template <typename T> T   *seg_array_try_ref_last (SegArray<T> *a)             { return a->count ? seg_array_slot(a, a->count - 1) : 0; }
+template <typename T> T    seg_array_pop          (SegArray<T> *a)             { T r = *seg_array_ref_last(a); a->count--; return r; }
+
+// Fresh slots are zeroed, but slots that are being reused
+// after a seg_array_clear() or seg_array_pop() are not.
+template <typename T>
+T *seg_array_push_slot (SegArray<T> *a) {
+    if (a->count == a->capacity) seg_array_add_segment(a);
+    return seg_array_slot(a, a->count++);
+}
+
+template <typename T>
+Void seg_array_push (SegArray<T> *a, T v) {
+    *seg_array_push_slot(a) = v;
+}
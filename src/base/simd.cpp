@@ -0,0 +1,374 @@
+#include "base/simd.h"
+
+#if ARCH_X64
+    #include <immintrin.h>
+    #define AVX2 [[gnu::target("avx2")]]
+#endif
+
+// =============================================================================
+// Scalar:
+// =============================================================================
+template <typename T>
+static U64 find_scalar (T *data, U64 from, U64 count, T value) {
+    for (U64 i = from; i < count; ++i) if (data[i] == value) return i;
+    return UINT64_MAX;
+}
+
+template <typename T>
+static U64 find_last_scalar (T *data, U64 count, T value) {
+    for (U64 i = count; i-- > 0;) if (data[i] == value) return i;
+    return UINT64_MAX;
+}
+
+static Bool in_set (SimdByteSet *s, U8 b) {
+    return s->bits[b / 64] & (1ull << (b % 64));
+}
+
+static U64 find_in_set_scalar (U8 *data, U64 from, U64 count, SimdByteSet *s) {
+    for (U64 i = from; i < count; ++i) if (in_set(s, data[i])) return i;
+    return UINT64_MAX;
+}
+
+static U64 set_mask_scalar (U8 *data, U64 count, SimdByteSet *s) {
+    U64 m = 0;
+    for (U64 i = 0; i < count; ++i) m |= static_cast<U64>(in_set(s, data[i])) << i;
+    return m;
+}
+
+// Branchless compaction of [from, count) to the position dst.
+template <typename T>
+static U64 remove_scalar (T *data, U64 from, U64 dst, U64 count, T value) {
+    for (U64 i = from; i < count; ++i) {
+        T x = data[i];
+        data[dst] = x;
+        dst += (x != value);
+    }
+    return dst;
+}
+
+Void simd_byte_set_init (SimdByteSet *s, U8 *set, U64 set_count) {
+    *s = {};
+
+    for (U64 i = 0; i < set_count; ++i) {
+        U8 b = set[i];
+        if (in_set(s, b)) continue;
+
+        s->bits[b / 64] |= 1ull << (b % 64);
+        if (s->count < SIMD_BYTE_SET_SMALL) s->bytes[s->count] = b;
+        s->count++;
+
+        U8 hi = b >> 4;
+        U8 *rows = (hi < 8) ? s->rows_lo : s->rows_hi;
+        rows[b & 15] |= 1 << (hi & 7);
+    }
+}
+
+U64 simd_find_any_u8 (U8 *data, U64 count, U8 *set, U64 set_count) {
+    SimdByteSet s;
+    simd_byte_set_init(&s, set, set_count);
+    return simd_find_in_set(data, count, &s);
+}
+
+#if ARCH_X64
+
+static Bool avx2_disabled;
+
+Bool cpu_has_avx2 () {
+    static Bool r = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return r && !avx2_disabled;
+}
+
+// For benchmarking the SSE2 paths on machines with AVX2.
+Void simd_disable_avx2 (Bool disable) {
+    avx2_disabled = disable;
+}
+
+// =============================================================================
+// SSE2:
+// =============================================================================
+template <typename T>
+static U32 sse2_match_mask (__m128i chunk, __m128i v) {
+    if constexpr (sizeof(T) == 1) {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, v));
+    } else if constexpr (sizeof(T) == 4) {
+        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(chunk, v)));
+    } else {
+        // SSE2 has no 64 bit compare so we combine the 32 bit
+        // compares of the two halves of each lane.
+        __m128i eq = _mm_cmpeq_epi32(chunk, v);
+        eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_movemask_pd(_mm_castsi128_pd(eq));
+    }
+}
+
+template <typename T>
+static __m128i sse2_splat (T value) {
+    if constexpr (sizeof(T) == 1)      return _mm_set1_epi8(value);
+    else if constexpr (sizeof(T) == 4) return _mm_set1_epi32(value);
+    else                               return _mm_set1_epi64x(value);
+}
+
+template <typename T>
+static U64 sse2_find (T *data, U64 count, T value) {
+    const U64 LANES = 16 / sizeof(T);
+    __m128i v = sse2_splat(value);
+    U64 i = 0;
+
+    for (; i + LANES <= count; i += LANES) {
+        U32 m = sse2_match_mask<T>(_mm_loadu_si128(reinterpret_cast<__m128i*>(data + i)), v);
+        if (m) return i + __builtin_ctz(m);
+    }
+
+    return find_scalar(data, i, count, value);
+}
+
+template <typename T>
+static U64 sse2_find_last (T *data, U64 count, T value) {
+    const U64 LANES = 16 / sizeof(T);
+    __m128i v = sse2_splat(value);
+    U64 i = count;
+
+    for (; i >= LANES; i -= LANES) {
+        U32 m = sse2_match_mask<T>(_mm_loadu_si128(reinterpret_cast<__m128i*>(data + i - LANES)), v);
+        if (m) return i - LANES + (31 - __builtin_clz(m));
+    }
+
+    return find_last_scalar(data, i, value);
+}
+
+// SSE2 has no byte shuffle, so for small sets we compare
+// against each member and for larger ones use the bitmap.
+static U32 sse2_set_mask (__m128i chunk, SimdByteSet *s) {
+    __m128i eq = _mm_setzero_si128();
+    for (U64 n = 0; n < s->count; ++n) eq = _mm_or_si128(eq, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(s->bytes[n])));
+    return _mm_movemask_epi8(eq);
+}
+
+static U64 sse2_find_in_set (U8 *data, U64 count, SimdByteSet *s) {
+    U64 i = 0;
+
+    if (s->count <= SIMD_BYTE_SET_SMALL) {
+        for (; i + 16 <= count; i += 16) {
+            U32 m = sse2_set_mask(_mm_loadu_si128(reinterpret_cast<__m128i*>(data + i)), s);
+            if (m) return i + __builtin_ctz(m);
+        }
+    }
+
+    return find_in_set_scalar(data, i, count, s);
+}
+
+static U64 sse2_set_mask_64 (U8 *data, SimdByteSet *s) {
+    if (s->count > SIMD_BYTE_SET_SMALL) return set_mask_scalar(data, 64, s);
+    U64 m = 0;
+    for (U64 i = 0; i < 64; i += 16) m |= static_cast<U64>(sse2_set_mask(_mm_loadu_si128(reinterpret_cast<__m128i*>(data + i)), s)) << i;
+    return m;
+}
+
+// Chunks without matches are moved with one store; only
+// chunks with matches go through the scalar compaction.
+template <typename T>
+static U64 sse2_remove (T *data, U64 count, T value) {
+    const U64 LANES = 16 / sizeof(T);
+    __m128i v = sse2_splat(value);
+    U64 dst = 0;
+    U64 i   = 0;
+
+    for (; i + LANES <= count; i += LANES) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i*>(data + i));
+
+        if (sse2_match_mask<T>(chunk, v)) {
+            dst = remove_scalar(data, i, dst, i + LANES, value);
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(data + dst), chunk);
+            dst += LANES;
+        }
+    }
+
+    return remove_scalar(data, i, dst, count, value);
+}
+
+// =============================================================================
+// AVX2:
+// =============================================================================
+// Each row holds the source lanes (for _mm256_permutevar8x32_epi32)
+// that have to be packed to the front given a mask of lanes to keep.
+struct CompressLut {
+    U8 idx[256][8];
+};
+
+static constexpr CompressLut make_compress_lut (U64 lanes) {
+    CompressLut lut = {};
+    U64 dwords_per_lane = 8 / lanes;
+
+    for (U64 mask = 0; mask < (1u << lanes); ++mask) {
+        U64 k = 0;
+        for (U64 lane = 0; lane < lanes; ++lane) {
+            if (! (mask & (1u << lane))) continue;
+            for (U64 d = 0; d < dwords_per_lane; ++d) lut.idx[mask][k++] = lane*dwords_per_lane + d;
+        }
+    }
+
+    return lut;
+}
+
+static constexpr CompressLut compress_lut32 = make_compress_lut(8);
+static constexpr CompressLut compress_lut64 = make_compress_lut(4);
+
+template <typename T>
+AVX2 static U32 avx2_match_mask (__m256i chunk, __m256i v) {
+    if constexpr (sizeof(T) == 1)      return _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, v));
+    else if constexpr (sizeof(T) == 4) return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(chunk, v)));
+    else                               return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(chunk, v)));
+}
+
+template <typename T>
+AVX2 static __m256i avx2_splat (T value) {
+    if constexpr (sizeof(T) == 1)      return _mm256_set1_epi8(value);
+    else if constexpr (sizeof(T) == 4) return _mm256_set1_epi32(value);
+    else                               return _mm256_set1_epi64x(value);
+}
+
+// Processes 2 vectors per iteration and only extracts
+// the exact position once either of them has a match.
+template <typename T>
+AVX2 static U64 avx2_find (T *data, U64 count, T value) {
+    const U64 LANES = 32 / sizeof(T);
+    __m256i v = avx2_splat(value);
+    U64 i = 0;
+
+    for (; i + 2*LANES <= count; i += 2*LANES) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i*>(data + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<__m256i*>(data + i + LANES));
+        U64 ma = avx2_match_mask<T>(a, v);
+        U64 mb = avx2_match_mask<T>(b, v);
+        if (ma | mb) return i + __builtin_ctzll(ma | (mb << LANES));
+    }
+
+    for (; i + LANES <= count; i += LANES) {
+        U32 m = avx2_match_mask<T>(_mm256_loadu_si256(reinterpret_cast<__m256i*>(data + i)), v);
+        if (m) return i + __builtin_ctz(m);
+    }
+
+    // Short inputs (and tails) are common for strings so
+    // take one more half width step before going scalar.
+    if (i + LANES/2 <= count) {
+        U32 m = sse2_match_mask<T>(_mm_loadu_si128(reinterpret_cast<__m128i*>(data + i)), _mm256_castsi256_si128(v));
+        if (m) return i + __builtin_ctz(m);
+        i += LANES/2;
+    }
+
+    return find_scalar(data, i, count, value);
+}
+
+template <typename T>
+AVX2 static U64 avx2_find_last (T *data, U64 count, T value) {
+    const U64 LANES = 32 / sizeof(T);
+    __m256i v = avx2_splat(value);
+    U64 i = count;
+
+    for (; i >= LANES; i -= LANES) {
+        U32 m = avx2_match_mask<T>(_mm256_loadu_si256(reinterpret_cast<__m256i*>(data + i - LANES)), v);
+        if (m) return i - LANES + (31 - __builtin_clz(m));
+    }
+
+    return find_last_scalar(data, i, value);
+}
+
+// Exact set membership for any set with two nibble lookups
+// (W. Muła's algorithm). For a byte with nibbles hi:lo, row
+// lo of the table holds a bit per hi nibble telling whether
+// hi:lo is in the set. There are 16 hi nibbles but only 8
+// bits per entry, so one table covers hi 0-7 and another hi
+// 8-15, and the top bit of the byte picks between them.
+AVX2 static __m256i avx2_set_table (U8 *rows) {
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<__m128i*>(rows)));
+}
+
+AVX2 static U32 avx2_set_mask (__m256i chunk, __m256i table_lo, __m256i table_hi) {
+    __m256i bits   = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                      1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i nibble = _mm256_set1_epi8(15);
+    __m256i lo     = _mm256_and_si256(chunk, nibble);
+    __m256i hi     = _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble);
+    __m256i row    = _mm256_blendv_epi8(_mm256_shuffle_epi8(table_lo, lo), _mm256_shuffle_epi8(table_hi, lo), chunk);
+    __m256i bit    = _mm256_shuffle_epi8(bits, hi);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+}
+
+AVX2 static U64 avx2_find_in_set (U8 *data, U64 count, SimdByteSet *s) {
+    __m256i table_lo = avx2_set_table(s->rows_lo);
+    __m256i table_hi = avx2_set_table(s->rows_hi);
+    U64 i = 0;
+
+    for (; i + 32 <= count; i += 32) {
+        U32 m = avx2_set_mask(_mm256_loadu_si256(reinterpret_cast<__m256i*>(data + i)), table_lo, table_hi);
+        if (m) return i + __builtin_ctz(m);
+    }
+
+    return find_in_set_scalar(data, i, count, s);
+}
+
+AVX2 static U64 avx2_set_mask_64 (U8 *data, SimdByteSet *s) {
+    __m256i table_lo = avx2_set_table(s->rows_lo);
+    __m256i table_hi = avx2_set_table(s->rows_hi);
+    U64 a = avx2_set_mask(_mm256_loadu_si256(reinterpret_cast<__m256i*>(data)), table_lo, table_hi);
+    U64 b = avx2_set_mask(_mm256_loadu_si256(reinterpret_cast<__m256i*>(data + 32)), table_lo, table_hi);
+    return a | (b << 32);
+}
+
+template <typename T>
+AVX2 static U64 avx2_remove (T *data, U64 count, T value) {
+    const U64 LANES = 32 / sizeof(T);
+    __m256i v = avx2_splat(value);
+    U64 dst = 0;
+    U64 i   = 0;
+
+    for (; i + LANES <= count; i += LANES) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i*>(data + i));
+        U32 matches   = avx2_match_mask<T>(chunk, v);
+
+        if (! matches) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + dst), chunk);
+            dst += LANES;
+        } else if constexpr (sizeof(T) == 1) {
+            dst = remove_scalar(data, i, dst, i + LANES, value);
+        } else {
+            // Since dst <= i the full width store only clobbers
+            // lanes of the chunk that was already loaded.
+            U32 keep = ~matches & ((1u << LANES) - 1);
+            const CompressLut *lut = (sizeof(T) == 4) ? &compress_lut32 : &compress_lut64;
+            __m256i perm = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(lut->idx[keep])));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + dst), _mm256_permutevar8x32_epi32(chunk, perm));
+            dst += popcount(keep);
+        }
+    }
+
+    return remove_scalar(data, i, dst, count, value);
+}
+
+U64 simd_find_u8      (U8 *data, U64 count, U8 value)                { return cpu_has_avx2() ? avx2_find(data, count, value) : sse2_find(data, count, value); }
+U64 simd_find_u32     (U32 *data, U64 count, U32 value)              { return cpu_has_avx2() ? avx2_find(data, count, value) : sse2_find(data, count, value); }
+U64 simd_find_u64     (U64 *data, U64 count, U64 value)              { return cpu_has_avx2() ? avx2_find(data, count, value) : sse2_find(data, count, value); }
+U64 simd_find_last_u8 (U8 *data, U64 count, U8 value)                { return cpu_has_avx2() ? avx2_find_last(data, count, value) : sse2_find_last(data, count, value); }
+U64 simd_find_in_set  (U8 *data, U64 count, SimdByteSet *s)          { return cpu_has_avx2() ? avx2_find_in_set(data, count, s) : sse2_find_in_set(data, count, s); }
+U64 simd_set_mask_64  (U8 *data, SimdByteSet *s)                     { return cpu_has_avx2() ? avx2_set_mask_64(data, s) : sse2_set_mask_64(data, s); }
+U64 simd_remove_u8    (U8 *data, U64 count, U8 value)                { return cpu_has_avx2() ? avx2_remove(data, count, value) : sse2_remove(data, count, value); }
+U64 simd_remove_u32   (U32 *data, U64 count, U32 value)              { return cpu_has_avx2() ? avx2_remove(data, count, value) : sse2_remove(data, count, value); }
+U64 simd_remove_u64   (U64 *data, U64 count, U64 value)              { return cpu_has_avx2() ? avx2_remove(data, count, value) : sse2_remove(data, count, value); }
+
+#else
+
+Bool cpu_has_avx2     ()             { return false; }
+Void simd_disable_avx2 (Bool disable) {}
+
+U64 simd_find_u8      (U8 *data, U64 count, U8 value)                { return find_scalar(data, 0, count, value); }
+U64 simd_find_u32     (U32 *data, U64 count, U32 value)              { return find_scalar(data, 0, count, value); }
+U64 simd_find_u64     (U64 *data, U64 count, U64 value)              { return find_scalar(data, 0, count, value); }
+U64 simd_find_last_u8 (U8 *data, U64 count, U8 value)                { return find_last_scalar(data, count, value); }
+U64 simd_find_in_set  (U8 *data, U64 count, SimdByteSet *s)          { return find_in_set_scalar(data, 0, count, s); }
+U64 simd_set_mask_64  (U8 *data, SimdByteSet *s)                     { return set_mask_scalar(data, 64, s); }
+U64 simd_remove_u8    (U8 *data, U64 count, U8 value)                { return remove_scalar(data, 0, 0, count, value); }
+U64 simd_remove_u32   (U32 *data, U64 count, U32 value)              { return remove_scalar(data, 0, 0, count, value); }
+U64 simd_remove_u64   (U64 *data, U64 count, U64 value)              { return remove_scalar(data, 0, 0, count, value); }
+
+#endif
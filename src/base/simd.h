@@ -0,0 +1,60 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// Vectorized kernels for searching and filtering buffers of
+// fixed width elements.
+//
+// On x86-64 the SSE2 versions are the baseline and the AVX2
+// versions are selected at runtime if the cpu supports them
+// (and simd_disable_avx2 wasn't called). Other architectures
+// use scalar loops.
+//
+// The find functions return the index of the first element
+// equal to the given value or UINT64_MAX (ARRAY_NIL_IDX) if
+// there is none. The find_last variant returns the last one
+// and the find_any and find_in_set variants the first byte that
+// is any of the bytes in the given set.
+//
+// A SimdByteSet is the prepared form of a set of bytes. It's
+// worth keeping around when searching repeatedly with the same
+// set. The set_mask_64 function classifies the 64 bytes at data
+// (all must be readable) and returns a bitmask where bit i tells
+// whether data[i] is in the set.
+//
+// The remove functions compact the buffer in place, keeping
+// the relative order of the elements that are *not* equal to
+// the value, and return the new element count. On AVX2 the
+// 32/64 bit versions emulate a compress-store with a lookup
+// table of lane permutations.
+// =============================================================================
+#include "base/core.h"
+
+// Sets up to this size get searched with SSE2 compares when
+// AVX2 isn't available; larger ones fall back to scalar code.
+const U64 SIMD_BYTE_SET_SMALL = 8;
+
+struct SimdByteSet {
+    alignas(16) U8 rows_lo[16]; // Nibble tables (see simd.cpp).
+    alignas(16) U8 rows_hi[16];
+    U64 bits[4];                // Bitmap of the members.
+    U8 bytes[SIMD_BYTE_SET_SMALL];
+    U64 count;                  // Distinct members.
+};
+
+Bool cpu_has_avx2       ();
+Void simd_disable_avx2  (Bool);
+Void simd_byte_set_init (SimdByteSet *, U8 *set, U64 set_count);
+
+U64 simd_find_u8      (U8 *data, U64 count, U8 value);
+U64 simd_find_u32     (U32 *data, U64 count, U32 value);
+U64 simd_find_u64     (U64 *data, U64 count, U64 value);
+U64 simd_find_last_u8 (U8 *data, U64 count, U8 value);
+U64 simd_find_any_u8  (U8 *data, U64 count, U8 *set, U64 set_count);
+U64 simd_find_in_set  (U8 *data, U64 count, SimdByteSet *);
+U64 simd_set_mask_64  (U8 *data, SimdByteSet *);
+U64 simd_remove_u8    (U8 *data, U64 count, U8 value);
+U64 simd_remove_u32   (U32 *data, U64 count, U32 value);
+U64 simd_remove_u64   (U64 *data, U64 count, U64 value);
@@ -0,0 +1,160 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A container that hands out 32 bit handles instead of pointers.
+// The values live densely packed in an Array, so iterating over
+// them is a linear sweep, while the handles go through a table
+// of slots that maps them to the current dense position.
+//
+// A handle packs a slot index with the generation of the slot.
+// Removing a value bumps the generation of its slot, so stale
+// handles are detected on lookup instead of dangling. Handle 0
+// (SLOT_MAP_NIL) is never handed out.
+//
+// Removal moves the last value into the hole (array_remove_fast)
+// which means that the dense order is not stable and pointers
+// into the dense array are invalidated by add/remove.
+//
+// This data structure is only suitable for POD types.
+//
+// Usage example:
+// --------------
+//
+//     Auto m = slot_map_new<Foo>(mem);
+//     SlotHandle h = slot_map_add(&m, Foo{});
+//     if (Foo *foo = slot_map_ref(&m, h)) foo->x = 42;
+//     slot_map_remove(&m, h);
+//     assert_dbg(! slot_map_ref(&m, h));
+//
+//     array_iter_ptr (foo, &m.dense) {
+//         SlotHandle h = slot_map_handle_of(&m, ARRAY_IDX);
+//     }
+//
+// =============================================================================
+#include "base/array.h"
+
+typedef U32 SlotHandle;
+
+const SlotHandle SLOT_MAP_NIL      = 0;
+const U32        SLOT_MAP_IDX_BITS = 20;
+const U32        SLOT_MAP_IDX_MASK = (1u << SLOT_MAP_IDX_BITS) - 1;
+const U32        SLOT_MAP_GEN_MASK = (1u << (32 - SLOT_MAP_IDX_BITS)) - 1;
+const U32        SLOT_MAP_MAX      = SLOT_MAP_IDX_MASK + 1;
+const U32        SLOT_MAP_NO_FREE  = UINT32_MAX;
+
+struct SlotMapSlot {
+    U32 idx; // Position in dense if occupied, else next free slot.
+    U32 gen; // Never 0.
+};
+
+template <typename T>
+struct SlotMap {
+    Array<T> dense;
+    Array<U32> dense_to_slot;
+    Array<SlotMapSlot> slots;
+    U32 free_slot;
+};
+
+inline SlotHandle slot_handle     (U32 slot, U32 gen) { return (gen << SLOT_MAP_IDX_BITS) | slot; }
+inline U32        slot_handle_idx (SlotHandle h)      { return h & SLOT_MAP_IDX_MASK; }
+inline U32        slot_handle_gen (SlotHandle h)      { return h >> SLOT_MAP_IDX_BITS; }
+inline U32        slot_gen_next   (U32 gen)           { return (gen == SLOT_MAP_GEN_MASK) ? 1 : gen + 1; }
+
+template <typename T>
+Void slot_map_init (SlotMap<T> *m, Mem *mem) {
+    array_init(&m->dense, mem);
+    array_init(&m->dense_to_slot, mem);
+    array_init(&m->slots, mem);
+    m->free_slot = SLOT_MAP_NO_FREE;
+}
+
+template <typename T>
+SlotMap<T> slot_map_new (Mem *mem) {
+    SlotMap<T> m;
+    slot_map_init(&m, mem);
+    return m;
+}
+
+template <typename T>
+Void slot_map_free (SlotMap<T> *m) {
+    array_free(&m->dense);
+    array_free(&m->dense_to_slot);
+    array_free(&m->slots);
+}
+
+// Invalidates all handles.
+template <typename T>
+Void slot_map_clear (SlotMap<T> *m) {
+    array_iter (slot, &m->dense_to_slot) {
+        SlotMapSlot *s = array_ref(&m->slots, slot);
+        s->gen = slot_gen_next(s->gen);
+        s->idx = m->free_slot;
+        m->free_slot = slot;
+    }
+
+    m->dense.count = 0;
+    m->dense_to_slot.count = 0;
+}
+
+template <typename T>
+SlotHandle slot_map_add (SlotMap<T> *m, T val) {
+    U32 slot;
+
+    if (m->free_slot != SLOT_MAP_NO_FREE) {
+        slot = m->free_slot;
+        m->free_slot = m->slots.data[slot].idx;
+    } else {
+        assert_always(m->slots.count < SLOT_MAP_MAX);
+        slot = m->slots.count;
+        array_push(&m->slots, SlotMapSlot{ .gen=1 });
+    }
+
+    SlotMapSlot *s = &m->slots.data[slot];
+    s->idx = m->dense.count;
+    array_push(&m->dense, val);
+    array_push(&m->dense_to_slot, slot);
+    return slot_handle(slot, s->gen);
+}
+
+// Returns 0 if the handle is stale or nil.
+template <typename T>
+T *slot_map_ref (SlotMap<T> *m, SlotHandle h) {
+    U32 slot = slot_handle_idx(h);
+    if (slot >= m->slots.count) return 0;
+    SlotMapSlot *s = &m->slots.data[slot];
+    return (s->gen == slot_handle_gen(h)) ? &m->dense.data[s->idx] : 0;
+}
+
+template <typename T> Bool slot_map_has        (SlotMap<T> *m, SlotHandle h) { return slot_map_ref(m, h) != 0; }
+template <typename T> T    slot_map_get        (SlotMap<T> *m, SlotHandle h) { T *r = slot_map_ref(m, h); assert_always(r); return *r; }
+template <typename T> U32  slot_map_dense_idx  (SlotMap<T> *m, SlotHandle h) { assert_always(slot_map_has(m, h)); return m->slots.data[slot_handle_idx(h)].idx; }
+template <typename T> U64  slot_map_count      (SlotMap<T> *m)               { return m->dense.count; }
+
+template <typename T>
+SlotHandle slot_map_handle_of (SlotMap<T> *m, U64 dense_idx) {
+    U32 slot = array_get(&m->dense_to_slot, dense_idx);
+    return slot_handle(slot, m->slots.data[slot].gen);
+}
+
+// Returns false if the handle is stale or nil.
+template <typename T>
+Bool slot_map_remove (SlotMap<T> *m, SlotHandle h) {
+    if (! slot_map_has(m, h)) return false;
+
+    U32 slot = slot_handle_idx(h);
+    SlotMapSlot *s = &m->slots.data[slot];
+
+    // Patch the slot of the last dense element which is
+    // about to be moved into the hole.
+    m->slots.data[array_get_last(&m->dense_to_slot)].idx = s->idx;
+    array_remove_fast(&m->dense, s->idx);
+    array_remove_fast(&m->dense_to_slot, s->idx);
+
+    s->gen = slot_gen_next(s->gen);
+    s->idx = m->free_slot;
+    m->free_slot = slot;
+    return true;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A struct-of-arrays container: each field of a record lives in
+// its own column, and all columns share the same count. A scan
+// over a single field then only touches the memory of that one
+// column instead of dragging whole records through the cache.
+//
+// The soa_column() function returns a Slice of one column which
+// works with the read-only array_* functions and iterators.
+//
+// Columns are indexed by position, so naming them with an enum
+// is recommended.
+//
+// This data structure is only suitable for POD types.
+//
+// Usage example:
+// --------------
+//
+//     enum { ENTRY_START, ENTRY_TAG, ENTRY_DURATION };
+//     Auto entries = soa_new<U64, U32, I64>(mem);
+//     soa_push(&entries, start, tag, duration);
+//
+//     I64 total = 0;
+//     Auto durations = soa_column<ENTRY_DURATION>(&entries);
+//     array_iter (d, &durations) total += d;
+//
+// =============================================================================
+#include <tuple>
+#include "base/array.h"
+
+template <typename... Fields>
+struct SoA {
+    std::tuple<Fields*...> columns;
+    U64 count;
+    U64 capacity;
+    Mem *mem;
+};
+
+template <U64 I, typename S> using SoaField = std::remove_pointer_t<std::tuple_element_t<I, Type(static_cast<S*>(0)->columns)>>;
+
+// Calls f(column_ptr) for each column in order.
+template <typename S, typename F>
+Void soa_each_column (S *s, const F &f) {
+    std::apply([&](Auto &... cols){ (f(cols), ...); }, s->columns);
+}
+
+template <typename... Fields>
+Void soa_init (SoA<Fields...> *s, Mem *mem) {
+    *s = { .mem=mem };
+}
+
+template <typename... Fields>
+SoA<Fields...> soa_new (Mem *mem) {
+    SoA<Fields...> s;
+    soa_init(&s, mem);
+    return s;
+}
+
+template <typename... Fields>
+Void soa_free (SoA<Fields...> *s) {
+    soa_each_column(s, [&](Auto &col){ if (col) mem_free(s->mem, .old_ptr=col, .old_size=(sizeof(*col) * s->capacity)); });
+    soa_init(s, s->mem);
+}
+
+template <typename... Fields>
+Void soa_increase_capacity (SoA<Fields...> *s, U64 n) {
+    assert_dbg(n);
+    U64 new_cap = safe_add(s->capacity, n);
+
+    soa_each_column(s, [&](Auto &col){
+        col = mem_grow(s->mem, Type(*col), .size=(sizeof(*col) * new_cap), .old_ptr=col, .old_size=(sizeof(*col) * s->capacity));
+    });
+
+    s->capacity = new_cap;
+}
+
+template <typename... Fields>
+Void soa_ensure_capacity (SoA<Fields...> *s, U64 n) {
+    assert_dbg(n);
+    U64 new_cap = s->capacity ?: n;
+    while ((new_cap - s->count) < n) new_cap = safe_mul(new_cap, 2lu);
+    U64 dt = new_cap - s->capacity;
+    if (dt) soa_increase_capacity(s, dt);
+}
+
+template <U64 I, typename... Fields>
+Slice<SoaField<I, SoA<Fields...>>> soa_column (SoA<Fields...> *s) {
+    return { .data=std::get<I>(s->columns), .count=s->count };
+}
+
+template <U64 I, typename... Fields>
+SoaField<I, SoA<Fields...>> *soa_ref (SoA<Fields...> *s, U64 idx) {
+    assert_always(idx < s->count);
+    return &std::get<I>(s->columns)[idx];
+}
+
+template <typename... Fields>
+std::tuple<Fields...> soa_get (SoA<Fields...> *s, U64 idx) {
+    assert_always(idx < s->count);
+    return std::apply([&](Auto... cols){ return std::tuple<Fields...>(cols[idx]...); }, s->columns);
+}
+
+template <typename... Fields>
+Void soa_set (SoA<Fields...> *s, U64 idx, std::type_identity_t<Fields>... vals) {
+    assert_always(idx < s->count);
+    std::apply([&](Auto... cols){ ((cols[idx] = vals), ...); }, s->columns);
+}
+
+template <typename... Fields>
+Void soa_push (SoA<Fields...> *s, std::type_identity_t<Fields>... vals) {
+    soa_ensure_capacity(s, 1);
+    s->count++;
+    soa_set(s, s->count - 1, vals...);
+}
+
+// Keeps the order of the remaining rows.
+template <typename... Fields>
+Void soa_remove (SoA<Fields...> *s, U64 idx) {
+    assert_always(idx < s->count);
+    U64 tail = s->count - idx - 1;
+    soa_each_column(s, [&](Auto &col){ memmove(&col[idx], &col[idx + 1], sizeof(*col) * tail); });
+    s->count--;
+}
+
+// Moves the last row into the hole.
+template <typename... Fields>
+Void soa_remove_fast (SoA<Fields...> *s, U64 idx) {
+    assert_always(idx < s->count);
+    soa_each_column(s, [&](Auto &col){ col[idx] = col[s->count - 1]; });
+    s->count--;
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// Sorting routines on raw buffers. The array_sort* functions
+// in array.h are wrappers around these.
+//
+// The comparison sort is a pattern-defeating quicksort (pdqsort
+// by Orson Peters) without the block partitioning. It falls back
+// to insertion sort for small ranges and to heapsort when too
+// many bad partitions happen, so the worst case is O(n log n).
+// The comparator is a template parameter so that it inlines:
+//
+//     sort_pdq(data, count, [](U64 *a, U64 *b){ return c_compare(a, b); });
+//
+// The comparator uses the same convention as the libc qsort:
+// a negative, zero or positive Int.
+//
+// The radix sort is an LSD sort with 8 bit digits. It takes a
+// function that extracts an unsigned key (U32 or U64) from an
+// element; the radix_key() overloads map signed integers and
+// floats to unsigned keys that sort in the same order. Digits
+// that are the same for all keys are skipped.
+//
+//     sort_radix(entries, count, [](Entry *e){ return radix_key(e->timestamp); });
+//
+// =============================================================================
+#include <type_traits>
+#include "base/mem.h"
+
+// Below this size partitions get sorted via insertion sort.
+const U64 SORT_INSERTION_THRESHOLD = 24;
+
+// Above this size the pivot is chosen via Tukey's ninther.
+const U64 SORT_NINTHER_THRESHOLD = 128;
+
+// Max elements moved by sort_partial_insertion before giving up.
+const U64 SORT_PARTIAL_INSERTION_LIMIT = 8;
+
+inline U32 radix_key (U32 x) { return x; }
+inline U64 radix_key (U64 x) { return x; }
+inline U32 radix_key (I32 x) { return static_cast<U32>(x) ^ (1u << 31); }
+inline U64 radix_key (I64 x) { return static_cast<U64>(x) ^ (1ull << 63); }
+inline U32 radix_key (F32 x) { U32 b = std::bit_cast<U32>(x); return (b >> 31) ? ~b : (b | (1u << 31)); }
+inline U64 radix_key (F64 x) { U64 b = std::bit_cast<U64>(x); return (b >> 63) ? ~b : (b | (1ull << 63)); }
+
+template <typename T, typename L>
+Void sort_insertion (T *begin, T *end, const L &less) {
+    if (begin == end) return;
+
+    for (T *cur = begin + 1; cur != end; ++cur) {
+        if (! less(*cur, *(cur - 1))) continue;
+        T tmp  = *cur;
+        T *sift = cur;
+        do { *sift = *(sift - 1); sift--; } while ((sift != begin) && less(tmp, *(sift - 1)));
+        *sift = tmp;
+    }
+}
+
+// Like sort_insertion but assumes that there is an element
+// before begin which is <= all elements in [begin, end).
+template <typename T, typename L>
+Void sort_insertion_unguarded (T *begin, T *end, const L &less) {
+    if (begin == end) return;
+
+    for (T *cur = begin + 1; cur != end; ++cur) {
+        if (! less(*cur, *(cur - 1))) continue;
+        T tmp  = *cur;
+        T *sift = cur;
+        do { *sift = *(sift - 1); sift--; } while (less(tmp, *(sift - 1)));
+        *sift = tmp;
+    }
+}
+
+// Attempts to insertion sort the range, but gives up if more
+// than SORT_PARTIAL_INSERTION_LIMIT elements had to be moved.
+// Returns true if the range got sorted.
+template <typename T, typename L>
+Bool sort_partial_insertion (T *begin, T *end, const L &less) {
+    if (begin == end) return true;
+    U64 limit = 0;
+
+    for (T *cur = begin + 1; cur != end; ++cur) {
+        if (! less(*cur, *(cur - 1))) continue;
+        T tmp  = *cur;
+        T *sift = cur;
+        do { *sift = *(sift - 1); sift--; } while ((sift != begin) && less(tmp, *(sift - 1)));
+        *sift = tmp;
+        limit += cur - sift;
+        if (limit > SORT_PARTIAL_INSERTION_LIMIT) return false;
+    }
+
+    return true;
+}
+
+template <typename T, typename L>
+Void sort_sift_down (T *data, U64 count, U64 idx, const L &less) {
+    T tmp = data[idx];
+
+    while (true) {
+        U64 child = 2*idx + 1;
+        if (child >= count) break;
+        if ((child + 1 < count) && less(data[child], data[child + 1])) child++;
+        if (! less(tmp, data[child])) break;
+        data[idx] = data[child];
+        idx = child;
+    }
+
+    data[idx] = tmp;
+}
+
+template <typename T, typename L>
+Void sort_heap (T *begin, T *end, const L &less) {
+    U64 n = end - begin;
+    for (U64 i = n / 2; i-- > 0;) sort_sift_down(begin, n, i, less);
+    for (U64 i = n; i-- > 1;) { swap(begin[0], begin[i]); sort_sift_down(begin, i, 0, less); }
+}
+
+template <typename T, typename L>
+Void sort3 (T *a, T *b, T *c, const L &less) {
+    if (less(*b, *a)) swap(*a, *b);
+    if (less(*c, *b)) swap(*b, *c);
+    if (less(*b, *a)) swap(*a, *b);
+}
+
+// Partitions [begin, end) around the pivot *begin. Elements
+// equal to the pivot go to the right. Returns the position of
+// the pivot after partitioning and sets already_partitioned if
+// no elements had to be swapped.
+template <typename T, typename L>
+T *sort_partition_right (T *begin, T *end, const L &less, Bool *already_partitioned) {
+    T pivot = *begin;
+    T *first = begin;
+    T *last  = end;
+
+    // The median of 3 guarantees an element >= pivot exists
+    // to the right, and an element <= pivot to the left.
+    while (less(*++first, pivot));
+
+    if (first - 1 == begin) { while ((first < last) && !less(*--last, pivot)); }
+    else                    { while (! less(*--last, pivot)); }
+
+    *already_partitioned = first >= last;
+
+    while (first < last) {
+        swap(*first, *last);
+        while (less(*++first, pivot));
+        while (! less(*--last, pivot));
+    }
+
+    T *pivot_pos = first - 1;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+    return pivot_pos;
+}
+
+// Partitions with elements equal to the pivot going to the
+// left. Used when there are many equal elements, since they
+// can then be skipped entirely. Returns the pivot position.
+template <typename T, typename L>
+T *sort_partition_left (T *begin, T *end, const L &less) {
+    T pivot = *begin;
+    T *first = begin;
+    T *last  = end;
+
+    while (less(pivot, *--last));
+
+    if (last + 1 == end) { while ((first < last) && !less(pivot, *++first)); }
+    else                 { while (! less(pivot, *++first)); }
+
+    while (first < last) {
+        swap(*first, *last);
+        while (less(pivot, *--last));
+        while (! less(pivot, *++first));
+    }
+
+    T *pivot_pos = last;
+    *begin = *pivot_pos;
+    *pivot_pos = pivot;
+    return pivot_pos;
+}
+
+template <typename T, typename L>
+Void sort_pdq_loop (T *begin, T *end, const L &less, U64 bad_allowed, Bool leftmost) {
+    while (true) {
+        U64 size = end - begin;
+
+        if (size < SORT_INSERTION_THRESHOLD) {
+            if (leftmost) sort_insertion(begin, end, less);
+            else          sort_insertion_unguarded(begin, end, less);
+            return;
+        }
+
+        // Choose pivot as median of 3 or pseudomedian of 9,
+        // and move it to begin.
+        U64 half = size / 2;
+
+        if (size > SORT_NINTHER_THRESHOLD) {
+            sort3(begin, begin + half, end - 1, less);
+            sort3(begin + 1, begin + (half - 1), end - 2, less);
+            sort3(begin + 2, begin + (half + 1), end - 3, less);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+            swap(*begin, *(begin + half));
+        } else {
+            sort3(begin + half, begin, end - 1, less);
+        }
+
+        // If the element before this range is not less than the
+        // pivot, then the pivot is the smallest element here and
+        // all elements equal to it can be put aside in one go.
+        if (!leftmost && !less(*(begin - 1), *begin)) {
+            begin = sort_partition_left(begin, end, less) + 1;
+            continue;
+        }
+
+        Bool already_partitioned;
+        T *pivot_pos = sort_partition_right(begin, end, less, &already_partitioned);
+
+        U64 l_size = pivot_pos - begin;
+        U64 r_size = end - (pivot_pos + 1);
+        Bool highly_unbalanced = (l_size < size / 8) || (r_size < size / 8);
+
+        if (highly_unbalanced) {
+            // Too many bad partitions means we are likely facing
+            // an adversarial input, so switch to heapsort.
+            if (--bad_allowed == 0) { sort_heap(begin, end, less); return; }
+
+            // Shuffle elements around to break patterns.
+            if (l_size >= SORT_INSERTION_THRESHOLD) {
+                U64 q = l_size / 4;
+                swap(*begin, *(begin + q));
+                swap(*(pivot_pos - 1), *(pivot_pos - q));
+
+                if (l_size > SORT_NINTHER_THRESHOLD) {
+                    swap(*(begin + 1), *(begin + q + 1));
+                    swap(*(begin + 2), *(begin + q + 2));
+                    swap(*(pivot_pos - 2), *(pivot_pos - q - 1));
+                    swap(*(pivot_pos - 3), *(pivot_pos - q - 2));
+                }
+            }
+
+            if (r_size >= SORT_INSERTION_THRESHOLD) {
+                U64 q = r_size / 4;
+                swap(*(pivot_pos + 1), *(pivot_pos + q + 1));
+                swap(*(end - 1), *(end - q));
+
+                if (r_size > SORT_NINTHER_THRESHOLD) {
+                    swap(*(pivot_pos + 2), *(pivot_pos + q + 2));
+                    swap(*(pivot_pos + 3), *(pivot_pos + q + 3));
+                    swap(*(end - 2), *(end - q - 1));
+                    swap(*(end - 3), *(end - q - 2));
+                }
+            }
+        } else if (already_partitioned &&
+                   sort_partial_insertion(begin, pivot_pos, less) &&
+                   sort_partial_insertion(pivot_pos + 1, end, less)) {
+            // The input was likely already sorted.
+            return;
+        }
+
+        // Recurse into the left part and loop on the right one.
+        sort_pdq_loop(begin, pivot_pos, less, bad_allowed, leftmost);
+        begin    = pivot_pos + 1;
+        leftmost = false;
+    }
+}
+
+template <typename T, typename F>
+Void sort_pdq (T *data, U64 count, const F &cmp) {
+    if (count < 2) return;
+    Auto less = [&](T &a, T &b) { return cmp(&a, &b) < 0; };
+    sort_pdq_loop(data, data + count, less, 64 - std::countl_zero(count), true);
+}
+
+template <typename T, typename F>
+Void sort_radix (T *data, U64 count, const F &key_of) {
+    using Key = decltype(key_of(data));
+    assert_static(std::is_unsigned_v<Key>);
+    const U64 DIGITS = sizeof(Key);
+
+    if (count < 2) return;
+
+    U64 histograms[DIGITS][256] = {};
+
+    for (U64 i = 0; i < count; ++i) {
+        Key k = key_of(&data[i]);
+        for (U64 d = 0; d < DIGITS; ++d) histograms[d][(k >> (8*d)) & 0xff]++;
+    }
+
+    tmem_new(tm);
+    T *src = data;
+    T *dst = mem_alloc(tm, T, .size=(count * sizeof(T)), .align=alignof(T));
+
+    for (U64 d = 0; d < DIGITS; ++d) {
+        U64 *h = histograms[d];
+        U64 sum = 0;
+        Bool trivial = false;
+
+        for (U64 b = 0; b < 256; ++b) {
+            if (h[b] == count) { trivial = true; break; }
+            U64 c = h[b];
+            h[b] = sum;
+            sum += c;
+        }
+
+        if (trivial) continue;
+
+        for (U64 i = 0; i < count; ++i) {
+            Key k = key_of(&src[i]);
+            dst[h[(k >> (8*d)) & 0xff]++] = src[i];
+        }
+
+        swap(src, dst);
+    }
+
+    if (src != data) memcpy(data, src, count * sizeof(T));
+}
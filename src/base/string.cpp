@@ -1,24 +1,84 @@
+#include <ctype.h>
 #include <errno.h>
+#include <locale.h>
+#include <math.h>
 #include <stdio.h>
 #include "base/string.h"
+#include "base/heap.h"
+#include "base/merge.h"
 
 // =============================================================================
 // String:
 // =============================================================================
+static const U64 POW10[20] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+    10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+    1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
 Bool    is_whitespace (Char c)               { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
-CString cstr          (Mem *mem, String s)   { return astr_fmt(mem, "%.*s%c", STR(s), 0).data; }
+CString cstr          (Mem *mem, String s)   { Auto p = mem_alloc(mem, Char, .size=(s.count + 1)); if (s.count) memcpy(p, s.data, s.count); p[s.count] = 0; return p; }
 String  str           (CString s)            { return (String){ .data=const_cast<Char*>(s), .count=strlen(s) }; }
-Bool    str_match     (String s1, String s2) { return (s1.count == s2.count) && (! strncmp(s1.data, s2.data, s1.count)); }
+Bool    str_match     (String s1, String s2) { return (s1.count == s2.count) && (! memcmp(s1.data, s2.data, s1.count)); }
 U64     istr_hash     (IString *i)           { return str_hash(*i); }
 U64     cstr_hash     (CString s)            { return str_hash(str(s)); }
 Bool    cstr_match    (CString a, CString b) { return str_match(str(a), str(b)); }
 Void    str_clear     (String s, U8 b)       { memset(s.data, b, s.count); }
 
-// Fnv64a
+// This is wyhash (final version 4) with a fixed seed. Inputs
+// up to 16 bytes are read with a few overlapping loads, while
+// longer inputs are consumed 48 bytes per loop iteration using
+// 3 independent lanes so that the multiplies can overlap.
+static const U64 WYHASH_SECRET[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+
+static U64 read_u64 (U8 *p) { U64 v; memcpy(&v, p, 8); return v; }
+static U64 read_u32 (U8 *p) { U32 v; memcpy(&v, p, 4); return v; }
+
 U64 str_hash (String str) {
-    U64 h = 0xcbf29ce484222325;
-    array_iter (b, &str) h = (h ^ static_cast<U64>(b)) * 0x01000193;
-    return h;
+    U8 *p    = reinterpret_cast<U8*>(str.data);
+    U64 len  = str.count;
+    U64 seed = hash_mix(WYHASH_SECRET[0], WYHASH_SECRET[1]);
+    U64 a    = 0;
+    U64 b    = 0;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            U64 m = (len >> 3) << 2;
+            a = (read_u32(p) << 32) | read_u32(p + m);
+            b = (read_u32(p + len - 4) << 32) | read_u32(p + len - 4 - m);
+        } else if (len > 0) {
+            a = (static_cast<U64>(p[0]) << 16) | (static_cast<U64>(p[len >> 1]) << 8) | p[len - 1];
+        }
+    } else {
+        U64 i = len;
+
+        if (i > 48) {
+            U64 see1 = seed;
+            U64 see2 = seed;
+
+            do {
+                seed = hash_mix(read_u64(p)      ^ WYHASH_SECRET[1], read_u64(p + 8)  ^ seed);
+                see1 = hash_mix(read_u64(p + 16) ^ WYHASH_SECRET[2], read_u64(p + 24) ^ see1);
+                see2 = hash_mix(read_u64(p + 32) ^ WYHASH_SECRET[3], read_u64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = hash_mix(read_u64(p) ^ WYHASH_SECRET[1], read_u64(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+
+        a = read_u64(p + i - 16);
+        b = read_u64(p + i - 8);
+    }
+
+    unsigned __int128 r = static_cast<unsigned __int128>(a ^ WYHASH_SECRET[1]) * (b ^ seed);
+    return hash_mix(static_cast<U64>(r) ^ WYHASH_SECRET[0] ^ len, static_cast<U64>(r >> 64) ^ WYHASH_SECRET[1]);
 }
 
 U64 hash (IString *istr) { return istr_hash(istr); }
@@ -39,13 +99,18 @@ Bool str_ends_with (String str, String suffix) {
 
 // Returns ARRAY_NIL_IDX if not found.
 U64 str_index_of_first (String str, U8 byte) {
-    return array_find(&str, [&](Auto it){ return it == byte; });
+    return simd_find_u8(reinterpret_cast<U8*>(str.data), str.count, byte);
 }
 
 // Returns ARRAY_NIL_IDX if not found.
 U64 str_index_of_last (String str, U8 byte) {
-    array_iter_back (c, &str) if (c == byte) return ARRAY_IDX;
-    return ARRAY_NIL_IDX;
+    return simd_find_last_u8(reinterpret_cast<U8*>(str.data), str.count, byte);
+}
+
+// Returns the index of the first byte that is any of the
+// given bytes or ARRAY_NIL_IDX if not found.
+U64 str_index_of_any (String str, String bytes) {
+    return simd_find_any_u8(reinterpret_cast<U8*>(str.data), str.count, reinterpret_cast<U8*>(bytes.data), bytes.count);
 }
 
 String str_slice (String str, U64 offset, U64 count) {
@@ -92,40 +157,228 @@ String str_suffix_from (String str, U64 from_idx) {
 
 // Non-inclusive.
 String str_prefix_to_first (String str, U8 byte) {
-    array_iter (c, &str) if (c == byte) return str_prefix_to(str, ARRAY_IDX);
-    return (String){};
+    U64 idx = str_index_of_first(str, byte);
+    return (idx == ARRAY_NIL_IDX) ? (String){} : str_prefix_to(str, idx);
 }
 
 // Non-inclusive.
 String str_prefix_to_last (String str, U8 byte) {
-    array_iter_back (c, &str) if (c == byte) return str_prefix_to(str, ARRAY_IDX);
-    return (String){};
+    U64 idx = str_index_of_last(str, byte);
+    return (idx == ARRAY_NIL_IDX) ? (String){} : str_prefix_to(str, idx);
 }
 
 // Non-inclusive.
 String str_suffix_from_last (String str, U8 byte) {
-    array_iter_back (c, &str) if (c == byte) return str_suffix_from(str, ARRAY_IDX + 1);
-    return (String){};
+    U64 idx = str_index_of_last(str, byte);
+    return (idx == ARRAY_NIL_IDX) ? (String){} : str_suffix_from(str, idx + 1);
 }
 
 // Non-inclusive.
 String str_suffix_from_first (String str, U8 byte) {
-    array_iter (c, &str) if (c == byte) return str_suffix_from(str, ARRAY_IDX + 1);
-    return (String){};
+    U64 idx = str_index_of_first(str, byte);
+    return (idx == ARRAY_NIL_IDX) ? (String){} : str_suffix_from(str, idx + 1);
 }
 
+// Like strtoul this skips leading whitespace and accepts a sign;
+// a negative number wraps around.
 Bool str_to_u64 (CString str, U64 *out, U64 base) {
-    errno = 0;
-    Char *endptr = 0;
-    *out = static_cast<U64>(std::strtoul(str, &endptr, base));
-    return (errno == 0) && (endptr != str);
+    while (isspace(*str)) str++;
+    Bool neg = (*str == '-');
+    if (*str == '-' || *str == '+') str++;
+
+    U64 v;
+    if (! str_parse_u64(::str(str), base, &v)) return false;
+    *out = neg ? 0 - v : v;
+    return true;
 }
 
+// Like strtod this skips leading whitespace.
 Bool str_to_f64 (CString str, F64 *out) {
-    errno = 0;
-    Char *endptr = 0;
-    *out = std::strtod(str, &endptr);
-    return (errno == 0) && (endptr != str);
+    while (isspace(*str)) str++;
+    return str_parse_f64(::str(str), out) != 0;
+}
+
+// Value of a digit in bases up to 36 or 36 if it's not one.
+static U64 digit_value (Char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+    return 36;
+}
+
+// The str_parse_* functions parse a number at the start of the
+// string and return how many bytes it took, or 0 if there is no
+// valid number there or it overflows. On failure the output is
+// left untouched. There is no skipping of whitespace.
+//
+// The base is 2 to 36 or 0 to detect it from a prefix like C does
+// (0x for 16, 0 for 8 and otherwise 10). With base 16 an optional
+// 0x prefix is accepted as well.
+U64 str_parse_u64 (String str, U64 base, U64 *out) {
+    assert_dbg(base == 0 || (base >= 2 && base <= 36));
+
+    U64 i = 0;
+    Bool hex_prefix = (str.count > 2) && (str.data[0] == '0') && (str.data[1] == 'x' || str.data[1] == 'X') && (digit_value(str.data[2]) < 16);
+
+    if (base == 0) {
+        if (hex_prefix)                                  { base = 16; i = 2; }
+        else if (str.count > 1 && str.data[0] == '0')    { base = 8; }
+        else                                             { base = 10; }
+    } else if (base == 16 && hex_prefix) {
+        i = 2;
+    }
+
+    U64 start = i;
+    U64 v = 0;
+
+    for (; i < str.count; ++i) {
+        U64 d = digit_value(str.data[i]);
+        if (d >= base) break;
+        if (__builtin_mul_overflow(v, base, &v) || __builtin_add_overflow(v, d, &v)) return 0;
+    }
+
+    if (i == start) return 0;
+    *out = v;
+    return i;
+}
+
+U64 str_parse_i64 (String str, U64 base, I64 *out) {
+    Bool neg  = (str.count > 0) && (str.data[0] == '-');
+    U64 sign  = (str.count > 0) && (str.data[0] == '-' || str.data[0] == '+');
+    U64 v     = 0;
+    U64 n     = str_parse_u64(str_suffix_from(str, sign), base, &v);
+
+    if (! n) return 0;
+    if (v > static_cast<U64>(INT64_MAX) + neg) return 0;
+    *out = neg ? static_cast<I64>(0 - v) : static_cast<I64>(v);
+    return sign + n;
+}
+
+static Bool match_lowercase (String str, U64 offset, CString lower) {
+    U64 n = strlen(lower);
+    if (str.count - offset < n) return false;
+    for (U64 i = 0; i < n; ++i) if ((str.data[offset + i] | 0x20) != lower[i]) return false;
+    return true;
+}
+
+// Handle of the C locale for the calls into libc that parse or
+// print numbers. The application runs under the user's locale
+// (GTK calls setlocale(LC_ALL, "") on startup), in which the
+// decimal point can be a comma.
+static locale_t c_locale () {
+    static locale_t l = newlocale(LC_ALL_MASK, "C", 0);
+    assert_always(l);
+    return l;
+}
+
+// Decimal floats like strtod without hex floats: an optional sign,
+// digits with an optional point and an optional exponent, or inf,
+// infinity and nan in any case.
+//
+// If the decimal mantissa fits in 19 digits and is at most 2^53,
+// and the power of 10 is at most 22 (so also exactly representable),
+// the result is the single correctly rounded multiplication or
+// division (Clinger's fast path). That covers the usual values in
+// logs and config files. Anything else is copied to a buffer on the
+// stack and given to strtod.
+//
+// Parsing does not depend on the locale: the decimal point is
+// always '.', and strtod runs under the C locale.
+U64 str_parse_f64 (String str, F64 *out) {
+    U64 i    = 0;
+    Bool neg = false;
+    if (i < str.count && (str.data[i] == '-' || str.data[i] == '+')) neg = (str.data[i++] == '-');
+
+    if (match_lowercase(str, i, "infinity")) { *out = neg ? -INFINITY : INFINITY; return i + 8; }
+    if (match_lowercase(str, i, "inf"))      { *out = neg ? -INFINITY : INFINITY; return i + 3; }
+    if (match_lowercase(str, i, "nan"))      { *out = neg ? -NAN : NAN; return i + 3; }
+
+    U64 mantissa      = 0;
+    U64 digits        = 0; // Significant ones in mantissa.
+    Bool truncated    = false;
+    I64 exp10         = 0;
+    U64 digits_start  = i;
+
+    for (; i < str.count && str.data[i] >= '0' && str.data[i] <= '9'; ++i) {
+        if (digits == 19) { truncated = true; exp10++; continue; }
+        mantissa = 10*mantissa + (str.data[i] - '0');
+        digits  += (mantissa != 0);
+    }
+
+    U64 int_digits = i - digits_start;
+
+    if (i < str.count && str.data[i] == '.') {
+        U64 frac_start = ++i;
+
+        for (; i < str.count && str.data[i] >= '0' && str.data[i] <= '9'; ++i) {
+            if (digits == 19) { truncated = true; continue; }
+            mantissa = 10*mantissa + (str.data[i] - '0');
+            digits  += (mantissa != 0);
+            exp10--;
+        }
+
+        if (int_digits == 0 && i == frac_start) return 0;
+    } else if (int_digits == 0) {
+        return 0;
+    }
+
+    if (i < str.count && (str.data[i] | 0x20) == 'e') {
+        U64 j = i + 1;
+        Bool exp_neg = false;
+        if (j < str.count && (str.data[j] == '-' || str.data[j] == '+')) exp_neg = (str.data[j++] == '-');
+
+        if (j < str.count && str.data[j] >= '0' && str.data[j] <= '9') {
+            I64 e = 0;
+            for (; j < str.count && str.data[j] >= '0' && str.data[j] <= '9'; ++j) if (e < 100000) e = 10*e + (str.data[j] - '0');
+            exp10 += exp_neg ? -e : e;
+            i = j;
+        }
+    }
+
+    static const F64 pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    // A mantissa with few digits can absorb part of a larger
+    // exponent and still be exact (1.5e30 = 15e28 = 15e6 * 1e22).
+    if (! truncated && exp10 > 22 && exp10 <= 22 + 18) {
+        U64 m;
+        if (! __builtin_mul_overflow(mantissa, POW10[exp10 - 22], &m) && m <= (1ull << 53)) { mantissa = m; exp10 = 22; }
+    }
+
+    if (! truncated && mantissa <= (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+        F64 v = static_cast<F64>(mantissa);
+        v = (exp10 < 0) ? v / pow10[-exp10] : v * pow10[exp10];
+        *out = neg ? -v : v;
+        return i;
+    }
+
+    if (mantissa == 0 && !truncated) {
+        *out = neg ? -0.0 : 0.0;
+        return i;
+    }
+
+    Auto slow_path = [&](Char *buf){
+        memcpy(buf, str.data, i);
+        buf[i] = 0;
+        locale_t prev = uselocale(c_locale());
+        errno = 0;
+        Char *end = 0;
+        F64 v = std::strtod(buf, &end);
+
+        // ERANGE is also set on underflow, but then the result
+        // is the correctly rounded subnormal or zero.
+        Bool overflow = (errno == ERANGE && fabs(v) == HUGE_VAL);
+        uselocale(prev);
+
+        if (end != buf + i || overflow) return 0lu;
+        *out = v;
+        return i;
+    };
+
+    // Only absurdly long numbers don't fit on the stack.
+    Char buf[128];
+    if (i < sizeof(buf)) return slow_path(buf);
+    tmem_new(tm);
+    return slow_path(mem_alloc(tm, Char, .size=(i + 1)));
 }
 
 String str_copy (Mem *mem, String str) {
@@ -135,6 +388,19 @@ String str_copy (Mem *mem, String str) {
     return (String){.data=p, .count=str.count};
 }
 
+// Bitmask of the separators in the 64 byte block at the given
+// offset. The last block is copied out so we don't read past
+// the end of the string.
+static U64 split_block_mask (SimdByteSet *seps, String str, U64 block) {
+    U8 *p = reinterpret_cast<U8*>(str.data + block);
+    if (block + 64 <= str.count) return simd_set_mask_64(p, seps);
+
+    U64 n = str.count - block;
+    U8 tail[64] = {};
+    memcpy(tail, p, n);
+    return simd_set_mask_64(tail, seps) & ((1ull << n) - 1);
+}
+
 // This function splits the given 'str' into tokens separated by
 // bytes that appear in the 'separators' string. For example, for
 // the inputs:
@@ -150,17 +416,118 @@ String str_copy (Mem *mem, String str) {
 //     3. [/] [a] [/] [b] [|] [c] [/] [/] [foobar] [/]
 //     4. [] [/] [a] [/] [b] [|] [c] [/] [] [/] [foobar] [/] []
 //
+// The separators are classified 64 bytes at a time into a bitmask
+// (see simd_set_mask_64) so the cost per byte does not depend on
+// the number of separators, and the tokens are then read off the
+// bitmask. The output array is sized once up front.
 Void str_split (String str, String separators, Bool keep_separators, Bool keep_empties, Array<String> *out) {
-    U64 prev_pos = 0;
+    Auto it = str_split_iter(str, separators, keep_separators, keep_empties);
+
+    U64 sep_count = 0;
+    for (U64 block = 0; block < str.count; block += 64) sep_count += popcount(split_block_mask(&it.seps, str, block));
+    array_ensure_capacity_min(out, sep_count + 1 + (keep_separators ? sep_count : 0));
+
+    String token;
+    while (str_split_next(&it, &token)) out->data[out->count++] = token;
+}
+
+StrSplitIter str_split_iter (String str, String separators, Bool keep_separators, Bool keep_empties) {
+    StrSplitIter it = { .str=str, .pending_sep=ARRAY_NIL_IDX, .keep_seps=keep_separators, .keep_empties=keep_empties };
+    simd_byte_set_init(&it.seps, reinterpret_cast<U8*>(separators.data), separators.count);
+    return it;
+}
+
+// Returns ARRAY_NIL_IDX when there are no more separators.
+static U64 split_next_sep (StrSplitIter *it) {
+    while (! it->mask) {
+        if (it->next_block >= it->str.count) return ARRAY_NIL_IDX;
+        it->mask = split_block_mask(&it->seps, it->str, it->next_block);
+        it->next_block += 64;
+    }
+
+    U64 idx = it->next_block - 64 + __builtin_ctzll(it->mask);
+    it->mask &= it->mask - 1;
+    return idx;
+}
+
+Bool str_split_next (StrSplitIter *it, String *out) {
+    while (true) {
+        if (it->pending_sep != ARRAY_NIL_IDX) {
+            *out = str_slice(it->str, it->pending_sep, 1);
+            it->pending_sep = ARRAY_NIL_IDX;
+            return true;
+        }
+
+        if (it->done) return false;
+
+        U64 idx = split_next_sep(it);
+
+        if (idx == ARRAY_NIL_IDX) {
+            it->done = true;
+            *out = str_slice(it->str, it->prev_pos, it->str.count - it->prev_pos);
+            return it->keep_empties || out->count;
+        }
+
+        *out = str_slice(it->str, it->prev_pos, idx - it->prev_pos);
+        it->prev_pos = idx + 1;
+        if (it->keep_seps) it->pending_sep = idx;
+        if (it->keep_empties || out->count) return true;
+    }
+}
 
-    array_iter (c, &str) {
-        if (! array_has(&separators, c)) continue;
-        if (keep_empties || (ARRAY_IDX > prev_pos)) array_push(out, str_slice(str, prev_pos, ARRAY_IDX - prev_pos));
-        if (keep_separators) array_push(out, str_slice(str, ARRAY_IDX, 1));
-        prev_pos = ARRAY_IDX + 1;
+// Returns one past the haystack idx at which the last byte of
+// the needle matched when searching forwards from the offset,
+// or ARRAY_NIL_IDX if there is no match.
+static U64 fuzzy_match_end (String needle, String haystack, U64 offset) {
+    if (needle.count == 0) return offset;
+    U64 needle_cursor = 0;
+
+    for (U64 i = offset; i < haystack.count; ++i) {
+        if (haystack.data[i] == needle.data[needle_cursor]) {
+            needle_cursor++;
+            if (needle_cursor == needle.count) return i + 1;
+        }
     }
 
-    if (keep_empties || (str.count > prev_pos)) array_push(out, str_slice(str, prev_pos, str.count - prev_pos));
+    return ARRAY_NIL_IDX;
+}
+
+// Computes the score while searching in reverse from the end of
+// a forward match. If indices is not NULL, it receives the haystack
+// idx of each needle byte.
+static I64 fuzzy_score_from_end (String needle, String haystack, U64 end, U64 *indices) {
+    I64 gaps            = 0;
+    I64 consecutives    = 0;
+    I64 word_beginnings = 0;
+    U64 needle_cursor   = needle.count - 1;
+    U64 prev_match_idx  = ARRAY_NIL_IDX;
+
+    array_iter_back_from (b, &haystack, end - 1) {
+        if (b != needle.data[needle_cursor]) {
+            gaps++;
+        } else {
+            if (indices) indices[needle_cursor] = ARRAY_IDX;
+            if ((ARRAY_IDX + 1) == prev_match_idx) consecutives++;
+            if ((ARRAY_IDX > 1) && is_whitespace(haystack.data[ARRAY_IDX - 1])) word_beginnings++;
+            if (needle_cursor == 0) break;
+            needle_cursor--;
+            prev_match_idx = ARRAY_IDX;
+        }
+    }
+
+    assert_dbg(needle_cursor == 0);
+    return max(INT64_MIN+1, (consecutives * 4) + (word_beginnings * 3) - gaps);
+}
+
+// See str_fuzzy_search(). This doesn't allocate, so it can
+// run on threads that have no TMem set up.
+static I64 fuzzy_score (String needle, String haystack, U64 *indices) {
+    if (needle.count == 0) return INT64_MIN;
+    if (needle.count > haystack.count) return INT64_MIN;
+
+    U64 end = fuzzy_match_end(needle, haystack, 0);
+    if (end == ARRAY_NIL_IDX) return INT64_MIN;
+    return fuzzy_score_from_end(needle, haystack, end, indices);
 }
 
 // This functions searches the haystack for the needle in a fuzzy way.
@@ -193,73 +560,122 @@ Void str_split (String str, String separators, Bool keep_separators, Bool keep_e
 // text were found, whether letters appear at word beginnings, number
 // of gaps between letters, ...
 I64 str_fuzzy_search (String needle, String haystack, Array<String> *tokens) {
-    if (needle.count == 0) return INT64_MIN;
-    if (needle.count > haystack.count) return INT64_MIN;
+    if (! tokens) return fuzzy_score(needle, haystack, 0);
 
-    U64 needle_cursor = 0;
-    U64 haystack_end  = 0;
+    tmem_new(tm);
+    SmallArray<U64, 32> indices; // Map from needle idx to haystack idx.
+    array_init(&indices, tm);
+    array_ensure_count(&indices, needle.count, 0);
 
-    { // 1. Search forwards to find the initial match:
-        array_iter (b, &haystack) {
-            if (b == needle.data[needle_cursor]) {
-                needle_cursor++;
-                if (needle_cursor == needle.count) { haystack_end = ARRAY_IDX; break; }
-            }
-        }
+    I64 score = fuzzy_score(needle, haystack, indices.data);
+    if (score == INT64_MIN) return score;
+
+    String token = str_slice(haystack, indices.data[0], 1);
 
-        if (needle_cursor != needle.count) return INT64_MIN;
-        needle_cursor--;
+    array_iter_from (i, &indices, 1) {
+        if (i == indices.data[ARRAY_IDX - 1] + 1) {
+            token.count++;
+        } else {
+            array_push(tokens, token);
+            token = str_slice(haystack, i, 1);
+        }
     }
 
-    tmem_new(tm);
-    Array<U64> indices; // Map from needle idx to haystack idx.
-    if (tokens) { array_init(&indices, tm); array_ensure_count(&indices, needle.count, 0); }
+    array_push(tokens, token);
+    array_push(tokens, str_slice(haystack, array_get_last(&indices) + 1, haystack.count));
+    return score;
+}
 
-    I64 gaps            = 0;
-    I64 consecutives    = 0;
-    I64 word_beginnings = 0;
+U64 str_char_mask (String str) {
+    U64 mask = 0;
+    array_iter (b, &str) mask |= 1ull << (b & 63);
+    return mask;
+}
 
-    { // 2. Compute score while searching again in reverse:
-        U64 prev_match_idx = ARRAY_NIL_IDX;
+struct FuzzyMatchCmp {
+    Int operator() (FuzzyMatch *a, FuzzyMatch *b) const {
+        if (a->score != b->score) return (a->score > b->score) ? -1 : 1;
+        return c_compare(&a->idx, &b->idx);
+    }
+};
 
-        array_iter_back_from (b, &haystack, haystack_end) {
-            if (b != needle.data[needle_cursor]) {
-                gaps++;
-            } else {
-                if (tokens) array_set(&indices, needle_cursor, ARRAY_IDX);
-                if ((ARRAY_IDX + 1) == prev_match_idx) consecutives++;
-                if ((ARRAY_IDX > 1) && is_whitespace(haystack.data[ARRAY_IDX - 1])) word_beginnings++;
-                if (needle_cursor == 0) break;
-                needle_cursor--;
-                prev_match_idx = ARRAY_IDX;
-            }
-        }
+// The haystacks are cut into one chunk per processor. Each thread
+// writes the matches of its chunk to the start of the chunk's range
+// in a shared array, and those are then compacted and given to
+// heap_top_k on the calling thread. The worker threads only call
+// fuzzy_score which doesn't need TMem.
+Void str_fuzzy_top_k (String needle, Slice<String> haystacks, Slice<U64> masks, U64 k, Array<FuzzyMatch> *out) {
+    assert_dbg(masks.count == 0 || masks.count == haystacks.count);
+    if (k == 0 || needle.count == 0 || haystacks.count == 0) return;
 
-        assert_dbg(needle_cursor == 0);
-    }
+    tmem_new(tm);
+    FuzzyMatch *matches = mem_alloc(tm, FuzzyMatch, .size=(haystacks.count * sizeof(FuzzyMatch)), .align=alignof(FuzzyMatch));
+    U64 needle_mask     = str_char_mask(needle);
 
-    if (tokens) { // 3. Emit tokens:
-        String token = str_slice(haystack, indices.data[0], 1);
+    U64 p = (haystacks.count < FUZZY_PARALLEL_MIN_COUNT) ? 1 : min(os_get_proc_count(), SORT_PARALLEL_MAX_THREADS);
+    U64 bounds[SORT_PARALLEL_MAX_THREADS + 1];
+    U64 counts[SORT_PARALLEL_MAX_THREADS];
+    for (U64 r = 0; r <= p; ++r) bounds[r] = haystacks.count * r / p;
 
-        array_iter_from (i, &indices, 1) {
-            if (i == indices.data[ARRAY_IDX - 1] + 1) {
-                token.count++;
-            } else {
-                array_push(tokens, token);
-                token = str_slice(haystack, i, 1);
-            }
+    parallel_for(p, [&](U64 r){
+        FuzzyMatch *cursor = matches + bounds[r];
+
+        for (U64 i = bounds[r]; i < bounds[r + 1]; ++i) {
+            if (masks.count && (masks.data[i] & needle_mask) != needle_mask) continue;
+            I64 score = fuzzy_score(needle, haystacks.data[i], 0);
+            if (score != INT64_MIN) *cursor++ = { score, i };
         }
 
-        array_push(tokens, token);
-        array_push(tokens, str_slice(haystack, array_get_last(&indices) + 1, haystack.count));
+        counts[r] = cursor - (matches + bounds[r]);
+    });
+
+    U64 total = counts[0];
+    for (U64 r = 1; r < p; ++r) {
+        memmove(matches + total, matches + bounds[r], counts[r] * sizeof(FuzzyMatch));
+        total += counts[r];
     }
 
-    return max(INT64_MIN+1, (consecutives * 4) + (word_beginnings * 3) - gaps);
+    heap_top_k<FuzzyMatch, FuzzyMatchCmp>(Slice<FuzzyMatch>{ matches, total }, k, out);
 }
 
 // =============================================================================
 // AString:
 // =============================================================================
+static const Char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Writes the digits of v so that they end right before end
+// and returns a pointer to the first one.
+static Char *fmt_dec (Char *end, U64 v) {
+    while (v >= 100) {
+        end -= 2;
+        memcpy(end, &DIGIT_PAIRS[2 * (v % 100)], 2);
+        v /= 100;
+    }
+
+    if (v >= 10) { end -= 2; memcpy(end, &DIGIT_PAIRS[2 * v], 2); }
+    else         { *--end = '0' + v; }
+
+    return end;
+}
+
+// Byte by byte so that the encoding does not depend on
+// the host; compilers merge this into a single store.
+template <U64 N>
+static Void push_le (AString *a, U64 v) {
+    Char *p = array_increase_count(a, N, false).data;
+    for (U64 i = 0; i < N; ++i) p[i] = static_cast<Char>(v >> (8 * i));
+}
+
 AString astr_new           (Mem *mem)                             { return array_new<Char>(mem); }
 AString astr_new_cap       (Mem *mem, U64 cap)                    { return array_new_cap<Char>(mem, cap); }
 Void    astr_print         (AString *a)                           { if (a->count) printf("%.*s", STR(*a)); }
@@ -275,30 +691,449 @@ Void    astr_push_str      (AString *a, String s)                 { array_push_m
 Void    astr_push_cstr     (AString *a, CString s)                { astr_push_str(a, String{ .data=const_cast<Char*>(s), .count=(U64)(strlen(s)) }); }
 Void    astr_push_cstr_nul (AString *a, CString s)                { astr_push_str(a, String{ .data=const_cast<Char*>(s), .count=(U64)(strlen(s) + 1) }); }
 Void    astr_push_2cstr    (AString *a, CString s1, CString s2)   { astr_push_cstr(a, s1); astr_push_cstr(a, s2); }
+Void    astr_push_u16      (AString *a, U16 v)                    { push_le<2>(a, v); }
+Void    astr_push_u32      (AString *a, U32 v)                    { push_le<4>(a, v); }
+Void    astr_push_u64      (AString *a, U64 v)                    { push_le<8>(a, v); }
+Void    astr_push_var_i64  (AString *a, I64 v)                    { astr_push_var_u64(a, (static_cast<U64>(v) << 1) ^ static_cast<U64>(v >> 63)); }
+Void    astr_push_dec_i64  (AString *a, I64 v)                    { if (v < 0) astr_push_byte(a, '-'); astr_push_dec_u64(a, (v < 0) ? 0 - static_cast<U64>(v) : v); }
+
+Void astr_push_var_u64 (AString *a, U64 v) {
+    array_ensure_capacity_min(a, 10);
+    U8 *p = reinterpret_cast<U8*>(a->data + a->count);
+    U64 n = 0;
+    while (v >= 0x80) { p[n++] = v | 0x80; v >>= 7; }
+    p[n++] = v;
+    a->count += n;
+}
+
+Void astr_push_dec_u64 (AString *a, U64 v) {
+    Char buf[20];
+    Char *end   = buf + sizeof(buf);
+    Char *start = fmt_dec(end, v);
+    astr_push_str(a, String{ start, static_cast<U64>(end - start) });
+}
 
+// Formats into the spare capacity and only formats a second
+// time if the result didn't fit.
 Void astr_push_fmt_va Fmt(2, 0) (AString *astr, CString fmt, VaList va) {
     VaList va2;
     va_copy(va2, va);
-    Int fmt_len = vsnprintf(0, 0, fmt, va);
+    U64 spare   = astr->capacity - astr->count;
+    Int fmt_len = vsnprintf(spare ? astr->data + astr->count : 0, spare, fmt, va);
     assert_always(fmt_len >= 0);
-    array_ensure_capacity(astr, fmt_len + 1);
-    vsnprintf(astr->data + astr->count, fmt_len + 1, fmt, va2);
+
+    if (static_cast<U64>(fmt_len) >= spare) {
+        array_ensure_capacity(astr, fmt_len + 1);
+        vsnprintf(astr->data + astr->count, fmt_len + 1, fmt, va2);
+    }
+
     astr->count += fmt_len;
     va_end(va2);
 }
 
-Void astr_push_fmt Fmt(2, 3) (AString *astr, CString fmt, ...) {
-    VaList va;
-    va_start(va, fmt);
-    astr_push_fmt_va(astr, fmt, va);
-    va_end(va);
+// =============================================================================
+// Formatting:
+// =============================================================================
+struct FmtSpec {
+    Bool left;
+    Bool plus;
+    Bool space;
+    Bool zero;
+    Bool alt;
+    U64 width;
+    I64 precision; // Negative if not given.
+    Char conv;
+};
+
+// The fast path for floats handles precisions up to this.
+const U64 FMT_FLOAT_MAX_PRECISION = 15;
+
+static Char *fmt_base (Char *end, U64 v, U64 base, Bool upper) {
+    CString digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    do { *--end = digits[v % base]; v /= base; } while (v);
+    return end;
+}
+
+// Pushes the prefix, leading zeros and body padded with
+// spaces to the width.
+static Void fmt_push_padded (AString *astr, FmtSpec *spec, String prefix, U64 zeros, String body) {
+    U64 len = prefix.count + zeros + body.count;
+    U64 pad = (spec->width > len) ? spec->width - len : 0;
+    if (len + pad == 0) return;
+
+    Char *p = array_increase_count(astr, len + pad, false).data;
+    if (! spec->left) { memset(p, ' ', pad); p += pad; }
+    memcpy(p, prefix.data, prefix.count); p += prefix.count;
+    memset(p, '0', zeros);                p += zeros;
+    memcpy(p, body.data, body.count);     p += body.count;
+    if (spec->left) memset(p, ' ', pad);
+}
+
+// With the zero flag numbers are padded with zeros instead
+// of spaces (unless left aligned).
+static U64 fmt_zero_pad (FmtSpec *spec, String prefix, U64 zeros, String body) {
+    if (!spec->zero || spec->left) return zeros;
+    U64 len = prefix.count + zeros + body.count;
+    return (spec->width > len) ? zeros + spec->width - len : zeros;
+}
+
+// Formats a single conversion with snprintf directly into
+// the spare capacity of the AString.
+static Void fmt_push_libc (AString *astr, FmtSpec *spec, FmtArg *arg) {
+    Char f[12];
+    U64 n = 0;
+    f[n++] = '%';
+    if (spec->left)  f[n++] = '-';
+    if (spec->plus)  f[n++] = '+';
+    if (spec->space) f[n++] = ' ';
+    if (spec->zero)  f[n++] = '0';
+    if (spec->alt)   f[n++] = '#';
+    f[n++] = '*';
+    f[n++] = '.';
+    f[n++] = '*';
+    f[n++] = spec->conv;
+    f[n]   = 0;
+
+    Int width     = static_cast<Int>(spec->width);
+    Int precision = static_cast<Int>(spec->precision);
+
+    Auto print = [&](Char *buf, U64 size){
+        return (arg->tag == FMT_ARG_FLOAT) ? snprintf(buf, size, f, width, precision, arg->f)
+                                           : snprintf(buf, size, f, width, precision, arg->p);
+    };
+
+    // The C locale so that the decimal point is '.' like in
+    // the output of fmt_push_float.
+    locale_t prev = uselocale(c_locale());
+    U64 spare     = astr->capacity - astr->count;
+    Int len       = print(spare ? astr->data + astr->count : 0, spare);
+    assert_always(len >= 0);
+
+    if (static_cast<U64>(len) >= spare) {
+        array_ensure_capacity(astr, len + 1);
+        print(astr->data + astr->count, len + 1);
+    }
+
+    uselocale(prev);
+    astr->count += len;
+}
+
+static Void fmt_push_int (AString *astr, FmtSpec *spec, FmtArg *arg) {
+    Bool neg = false;
+    U64 v    = arg->u;
+
+    if (arg->tag != FMT_ARG_UINT) {
+        if (spec->conv == 'd' || spec->conv == 'i') {
+            neg = arg->i < 0;
+            v   = neg ? 0 - arg->u : arg->u;
+        } else if (arg->size < 8) {
+            // Negative values in unsigned conversions are
+            // reinterpreted with the width of their type.
+            v &= (1ull << (8 * arg->size)) - 1;
+        }
+    }
+
+    Char buf[24];
+    Char *end   = buf + sizeof(buf);
+    Char *start = end;
+
+    switch (spec->conv) {
+    case 'x': start = fmt_base(end, v, 16, false); break;
+    case 'X': start = fmt_base(end, v, 16, true); break;
+    case 'o': start = fmt_base(end, v, 8, false); break;
+    default:  start = fmt_dec(end, v); break;
+    }
+
+    String body = { start, static_cast<U64>(end - start) };
+    U64 zeros   = 0;
+
+    if (spec->precision >= 0) {
+        if (spec->precision == 0 && v == 0) body.count = 0;
+        if (static_cast<U64>(spec->precision) > body.count) zeros = spec->precision - body.count;
+    }
+
+    String prefix = {};
+    if (neg)              prefix = str("-");
+    else if (spec->plus  && (spec->conv == 'd' || spec->conv == 'i')) prefix = str("+");
+    else if (spec->space && (spec->conv == 'd' || spec->conv == 'i')) prefix = str(" ");
+
+    if (spec->alt && v) {
+        if (spec->conv == 'x') prefix = str("0x");
+        if (spec->conv == 'X') prefix = str("0X");
+    }
+
+    if (spec->alt && spec->conv == 'o' && zeros == 0 && (body.count == 0 || body.data[0] != '0')) zeros = 1;
+    if (spec->precision < 0) zeros = fmt_zero_pad(spec, prefix, zeros, body);
+    fmt_push_padded(astr, spec, prefix, zeros, body);
+}
+
+// Fixed point formatting of values whose scaled magnitude fits
+// comfortably in the 53 bit mantissa. The product with the power
+// of 10 is rounded, but the fma() gives us the exact residual so
+// the result gets rounded like printf would (half to even on the
+// exact binary value). Everything else goes to libc.
+static Void fmt_push_float (AString *astr, FmtSpec *spec, FmtArg *arg) {
+    F64 v    = arg->f;
+    U64 prec = (spec->precision < 0) ? 6 : spec->precision;
+
+    if ((spec->conv != 'f' && spec->conv != 'F') || prec > FMT_FLOAT_MAX_PRECISION || !isfinite(v) || fabs(v) * POW10[prec] >= 0x1p52) {
+        fmt_push_libc(astr, spec, arg);
+        return;
+    }
+
+    F64 a      = fabs(v);
+    F64 p10    = static_cast<F64>(POW10[prec]);
+    F64 scaled = a * p10;
+    F64 err    = fma(a, p10, -scaled);
+    F64 r      = floor(scaled);
+    F64 frac   = scaled - r;
+
+    if (frac > 0.5 || (frac == 0.5 && (err > 0 || (err == 0 && fmod(r, 2) != 0)))) r += 1;
+
+    U64 n = static_cast<U64>(r);
+    Char buf[48];
+    Char *end   = buf + sizeof(buf);
+    Char *start = end;
+
+    if (prec) {
+        Char *frac_start = fmt_dec(end, n % POW10[prec]);
+        while (end - frac_start < static_cast<I64>(prec)) *--frac_start = '0';
+        start = frac_start;
+        *--start = '.';
+    } else if (spec->alt) {
+        *--start = '.';
+    }
+
+    start = fmt_dec(start, n / POW10[prec]);
+
+    String body   = { start, static_cast<U64>(end - start) };
+    String prefix = signbit(v) ? str("-") : spec->plus ? str("+") : spec->space ? str(" ") : String{};
+    fmt_push_padded(astr, spec, prefix, fmt_zero_pad(spec, prefix, 0, body), body);
+}
+
+static Void fmt_push_arg (AString *astr, FmtSpec *spec, FmtArg *arg) {
+    switch (spec->conv) {
+    case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+        fmt_push_int(astr, spec, arg);
+        break;
+    case 'c': {
+        Char c = static_cast<Char>(arg->i);
+        fmt_push_padded(astr, spec, {}, 0, String{ &c, 1 });
+    } break;
+    case 's': {
+        String s;
+        if (arg->tag == FMT_ARG_STR) s = arg->str;
+        else if (! arg->s)           s = str("(null)");
+        else                         s = { const_cast<Char*>(arg->s), (spec->precision < 0) ? strlen(arg->s) : strnlen(arg->s, spec->precision) };
+        if (spec->precision >= 0) s.count = min(s.count, static_cast<U64>(spec->precision));
+        fmt_push_padded(astr, spec, {}, 0, s);
+    } break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        fmt_push_float(astr, spec, arg);
+        break;
+    default:
+        fmt_push_libc(astr, spec, arg);
+        break;
+    }
+}
+
+// The format was validated by fmt_check() at compile time.
+Void astr_push_fmt_args (AString *astr, CString fmt, FmtArg *args, U64 arg_count) {
+    U64 arg = 0;
+    CString p = fmt;
+
+    while (true) {
+        CString lit = p;
+        while (*p && *p != '%') p++;
+        if (p > lit) astr_push_str(astr, String{ const_cast<Char*>(lit), static_cast<U64>(p - lit) });
+        if (! *p) break;
+        p++;
+
+        if (*p == '%') {
+            astr_push_byte(astr, '%');
+            p++;
+            continue;
+        }
+
+        FmtSpec spec = { .precision=-1 };
+
+        for (;; ++p) {
+            if (*p == '-')      spec.left = true;
+            else if (*p == '+') spec.plus = true;
+            else if (*p == ' ') spec.space = true;
+            else if (*p == '0') spec.zero = true;
+            else if (*p == '#') spec.alt = true;
+            else break;
+        }
+
+        if (*p == '*') {
+            I64 w = args[arg++].i;
+            if (w < 0) { spec.left = true; w = -w; }
+            spec.width = w;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') spec.width = 10*spec.width + (*p++ - '0');
+        }
+
+        if (*p == '.') {
+            p++;
+            spec.precision = 0;
+
+            if (*p == '*') {
+                spec.precision = max(args[arg++].i, -1l);
+                p++;
+            } else {
+                while (*p >= '0' && *p <= '9') spec.precision = 10*spec.precision + (*p++ - '0');
+            }
+        }
+
+        while (*p == 'h' || *p == 'l' || *p == 'L' || *p == 'q' || *p == 'j' || *p == 'z' || *p == 't') p++;
+        spec.conv = *p++;
+        assert_dbg(arg < arg_count);
+        fmt_push_arg(astr, &spec, &args[arg++]);
+    }
+}
+
+// =============================================================================
+// BinReader:
+// =============================================================================
+BinReader bin_reader_new  (String data)   { return { .data=data }; }
+U64       bin_reader_left (BinReader *r)  { return r->data.count - r->pos; }
+
+template <U64 N, typename T>
+static Bool read_le (BinReader *r, T *out) {
+    if (bin_reader_left(r) < N) return false;
+    U8 *p = reinterpret_cast<U8*>(r->data.data + r->pos);
+    U64 v = 0;
+    for (U64 i = 0; i < N; ++i) v |= static_cast<U64>(p[i]) << (8 * i);
+    *out = static_cast<T>(v);
+    r->pos += N;
+    return true;
 }
 
-String astr_fmt Fmt(2, 3) (Mem *mem, CString fmt, ...) {
-    AString astr = astr_new(mem);
-    VaList va;
-    va_start(va, fmt);
-    astr_push_fmt_va(&astr, fmt, va);
-    va_end(va);
-    return astr_to_str(&astr);
+Bool bin_read_u8  (BinReader *r, U8 *out)  { return read_le<1>(r, out); }
+Bool bin_read_u16 (BinReader *r, U16 *out) { return read_le<2>(r, out); }
+Bool bin_read_u32 (BinReader *r, U32 *out) { return read_le<4>(r, out); }
+Bool bin_read_u64 (BinReader *r, U64 *out) { return read_le<8>(r, out); }
+
+// Fails on truncation and on encodings longer than 10 bytes
+// or with bits past the 64th.
+Bool bin_read_var_u64 (BinReader *r, U64 *out) {
+    U8 *p = reinterpret_cast<U8*>(r->data.data + r->pos);
+    U64 left = bin_reader_left(r);
+    U64 v = 0;
+
+    for (U64 i = 0; i < min(left, 10lu); ++i) {
+        U64 b = p[i] & 0x7f;
+        if (i == 9 && b > 1) return false;
+        v |= b << (7 * i);
+
+        if (! (p[i] & 0x80)) {
+            *out = v;
+            r->pos += i + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Bool bin_read_var_i64 (BinReader *r, I64 *out) {
+    U64 v;
+    if (! bin_read_var_u64(r, &v)) return false;
+    *out = static_cast<I64>((v >> 1) ^ (0 - (v & 1)));
+    return true;
+}
+
+// The output is a slice into the data; nothing is copied.
+Bool bin_read_bytes (BinReader *r, U64 count, String *out) {
+    if (bin_reader_left(r) < count) return false;
+    *out = str_slice(r->data, r->pos, count);
+    r->pos += count;
+    return true;
+}
+
+// =============================================================================
+// FuzzySession:
+// =============================================================================
+FuzzySession fuzzy_session_new (Mem *mem, Slice<String> haystacks, Slice<U64> masks) {
+    assert_always(masks.count == 0 || masks.count == haystacks.count);
+    return { .mem=mem, .haystacks=haystacks, .masks=masks, .query=astr_new(mem), .levels=array_new<FuzzyLevel>(mem) };
+}
+
+static Void fuzzy_level_free (FuzzyLevel *level) {
+    array_free(&level->matches);
+    array_free(&level->ends);
+}
+
+static Void fuzzy_session_pop (FuzzySession *s) {
+    fuzzy_level_free(array_ref_last(&s->levels));
+    s->levels.count--;
+    s->query.count = s->levels.count ? array_ref_last(&s->levels)->query_count : 0;
+}
+
+Void fuzzy_session_free (FuzzySession *s) {
+    while (s->levels.count) fuzzy_session_pop(s);
+    array_free(&s->levels);
+    array_free(&s->query);
+}
+
+// Can be called from any thread.
+Void fuzzy_session_cancel (FuzzySession *s) {
+    static_cast<Void>(atomic_inc_load(&s->generation));
+}
+
+// Checks the candidates of the top level (or all haystacks if
+// there are no levels) against the query and pushes the ones
+// that match as a new level. Only the bytes added since the top
+// level need to be searched forwards, starting where the match
+// of the top level ended. Returns false if cancelled.
+static Bool fuzzy_session_refine (FuzzySession *s, String query, U64 generation) {
+    FuzzyLevel *top  = s->levels.count ? array_ref_last(&s->levels) : 0;
+    U64 added_start  = top ? top->query_count : 0;
+    String added     = str_suffix_from(query, added_start);
+    U64 added_mask   = str_char_mask(added);
+    U64 count        = top ? top->matches.count : s->haystacks.count;
+
+    FuzzyLevel level = { .query_count=query.count, .matches=array_new<FuzzyMatch>(s->mem), .ends=array_new<U64>(s->mem) };
+
+    for (U64 i = 0; i < count; ++i) {
+        if ((i % FUZZY_CANCEL_CHECK_INTERVAL == 0) && (atomic_load(&s->generation) != generation)) {
+            fuzzy_level_free(&level);
+            return false;
+        }
+
+        U64 idx   = top ? top->matches.data[i].idx : i;
+        U64 start = top ? top->ends.data[i] : 0;
+
+        if (s->masks.count && (s->masks.data[idx] & added_mask) != added_mask) continue;
+
+        String haystack = s->haystacks.data[idx];
+        U64 end = fuzzy_match_end(added, haystack, start);
+        if (end == ARRAY_NIL_IDX) continue;
+
+        array_push(&level.matches, FuzzyMatch{ fuzzy_score_from_end(query, haystack, end, 0), idx });
+        array_push(&level.ends, end);
+    }
+
+    array_push(&s->levels, level);
+    astr_push_str(&s->query, added);
+    return true;
+}
+
+// Sets the query and appends the k best matches to out as
+// str_fuzzy_top_k() would. Returns false without touching
+// out if fuzzy_session_cancel() was called meanwhile.
+Bool fuzzy_session_update (FuzzySession *s, String query, U64 k, Array<FuzzyMatch> *out) {
+    U64 generation = atomic_load(&s->generation);
+
+    U64 common = 0;
+    while (common < min(query.count, s->query.count) && query.data[common] == s->query.data[common]) common++;
+    while (s->levels.count && array_ref_last(&s->levels)->query_count > common) fuzzy_session_pop(s);
+
+    if (query.count == 0) return true;
+    if (query.count > s->query.count && ! fuzzy_session_refine(s, query, generation)) return false;
+
+    heap_top_k<FuzzyMatch, FuzzyMatchCmp>(slice(&array_ref_last(&s->levels)->matches), k, out);
+    return true;
 }
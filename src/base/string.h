@@ -1,5 +1,6 @@
 #pragma once
 
+#include <type_traits>
 #include "base/array.h"
 
 // =============================================================================
@@ -27,6 +28,7 @@ String    str_slice             (String, U64 offset, U64 count);
 String    str_trim              (String);
 U64       str_index_of_first    (String, U8 byte);
 U64       str_index_of_last     (String, U8 byte);
+U64       str_index_of_any      (String, String bytes);
 String    str_cut_prefix        (String, String prefix);
 String    str_cut_suffix        (String, String suffix);
 String    str_prefix_to         (String, U64);
@@ -38,12 +40,61 @@ String    str_suffix_from_last  (String, U8 byte);
 Void      str_clear             (String, U8 byte);
 Bool      str_to_u64            (CString, U64 *out, U64 base);
 Bool      str_to_f64            (CString, F64 *out);
+U64       str_parse_u64         (String, U64 base, U64 *out);
+U64       str_parse_i64         (String, U64 base, I64 *out);
+U64       str_parse_f64         (String, F64 *out);
 Void      str_split             (String, String seps, Bool keep_seps, Bool keep_empties, Array<String> *);
 I64       str_fuzzy_search      (String needle, String haystack, Array<String> *);
 String    str_copy              (Mem *, String);
 
 inline Bool compare (String a, String b) { return str_match(a, b); }
 
+// Lazy version of str_split() that yields one token at a time
+// without materializing an array:
+//
+//     Auto it = str_split_iter(text, str("\n"), false, false);
+//     for (String line; str_split_next(&it, &line);) ...
+//
+struct StrSplitIter {
+    String str;
+    SimdByteSet seps;
+    U64 mask;        // Unconsumed separators of the current 64 byte block.
+    U64 next_block;  // Offset of the block after the current one.
+    U64 prev_pos;    // Start of the next token.
+    U64 pending_sep; // Separator to emit next or ARRAY_NIL_IDX.
+    Bool keep_seps;
+    Bool keep_empties;
+    Bool done;
+};
+
+StrSplitIter str_split_iter (String, String seps, Bool keep_seps, Bool keep_empties);
+Bool         str_split_next (StrSplitIter *, String *out);
+
+// Runs str_fuzzy_search() over many haystacks and appends the k
+// best matches to out, best first (ties go to the lower index).
+//
+// The masks are optional. If given, masks[i] must be the
+// str_char_mask() of haystacks[i], and any haystack that lacks
+// a byte of the needle is rejected without being scanned, so
+// it pays to compute them once when the haystacks are loaded:
+//
+//     Array<U64> masks = array_new_cap<U64>(mem, todos.count);
+//     array_iter (todo, &todos) array_push(&masks, str_char_mask(todo));
+//     ...
+//     str_fuzzy_top_k(needle, slice(&todos), slice(&masks), 50, &results);
+//
+// Large batches are scored on all processors in parallel.
+struct FuzzyMatch {
+    I64 score;
+    U64 idx; // Into the haystacks.
+};
+
+// Below this count str_fuzzy_top_k runs on the calling thread.
+const U64 FUZZY_PARALLEL_MIN_COUNT = 1 << 14;
+
+U64  str_char_mask   (String);
+Void str_fuzzy_top_k (String needle, Slice<String> haystacks, Slice<U64> masks, U64 k, Array<FuzzyMatch> *out);
+
 // =============================================================================
 // AString: Wrapper around Array for string building.
 // =============================================================================
@@ -59,8 +110,12 @@ Void    astr_push_u8         (AString *, U8);
 Void    astr_push_2u8        (AString *, U8, U8);
 Void    astr_push_3u8        (AString *, U8, U8, U8);
 Void    astr_push_u16        (AString *, U16);
-Void    astr_push_u32        (AString *, U64);
+Void    astr_push_u32        (AString *, U32);
 Void    astr_push_u64        (AString *, U64);
+Void    astr_push_var_u64    (AString *, U64);
+Void    astr_push_var_i64    (AString *, I64);
+Void    astr_push_dec_u64    (AString *, U64);
+Void    astr_push_dec_i64    (AString *, I64);
 Void    astr_push_byte       (AString *, U8);
 Void    astr_push_bytes      (AString *, U8 byte, U64 n_times);
 Void    astr_push_str        (AString *, String);
@@ -68,5 +123,263 @@ Void    astr_push_cstr       (AString *, CString);
 Void    astr_push_2cstr      (AString *, CString, CString);
 Void    astr_push_cstr_nul   (AString *, CString);
 Void    astr_push_fmt_va     Fmt(2, 0) (AString *, CString fmt, VaList);
-Void    astr_push_fmt        Fmt(2, 3) (AString *, CString fmt, ...);
-String  astr_fmt             Fmt(2, 3) (Mem *, CString fmt, ...);
+
+// =============================================================================
+// BinReader:
+// ----------
+//
+// Bounds checked decoding of the binary encodings written by the
+// astr_push_* functions:
+//
+//   - astr_push_u16/u32/u64 write fixed width little endian.
+//   - astr_push_var_u64 writes LEB128 (7 bits per byte, low
+//     groups first, high bit set on all but the last byte).
+//   - astr_push_var_i64 writes the zigzag mapping of the value
+//     (0, -1, 1, -2, ... to 0, 1, 2, 3, ...) as LEB128, so small
+//     negative numbers stay short.
+//
+// The read functions return false and leave the position as it
+// was if the data is truncated or malformed.
+//
+//     Auto r = bin_reader_new(msg);
+//     U32 tag; U64 len; String body;
+//     if (! bin_read_u32(&r, &tag) || ! bin_read_var_u64(&r, &len) || ! bin_read_bytes(&r, len, &body)) return false;
+//
+// =============================================================================
+struct BinReader {
+    String data;
+    U64 pos;
+};
+
+BinReader bin_reader_new   (String);
+U64       bin_reader_left  (BinReader *);
+Bool      bin_read_u8      (BinReader *, U8 *out);
+Bool      bin_read_u16     (BinReader *, U16 *out);
+Bool      bin_read_u32     (BinReader *, U32 *out);
+Bool      bin_read_u64     (BinReader *, U64 *out);
+Bool      bin_read_var_u64 (BinReader *, U64 *out);
+Bool      bin_read_var_i64 (BinReader *, I64 *out);
+Bool      bin_read_bytes   (BinReader *, U64 count, String *out);
+
+// =============================================================================
+// Formatting:
+// -----------
+//
+// The astr_push_fmt() and astr_fmt() functions take printf style
+// format strings, but are templates that know the types of their
+// arguments:
+//
+//   - The format string is checked against the argument types at
+//     compile time, so a mismatch (or a non-literal format) is a
+//     compile error. Use astr_push_fmt_va() for runtime formats.
+//
+//   - The arguments are passed to a single formatting routine as
+//     an array of tagged values. Integers and fixed point floats
+//     are formatted directly into the AString without going through
+//     libc; the rarer conversions (%e, %g, %p, ...) fall back to
+//     snprintf on that one conversion.
+//
+//   - Length modifiers (l, ll, z, ...) are accepted but ignored
+//     since the size of each argument is known.
+//
+//   - Besides CString, %s also accepts a String, so the usual
+//     "%.*s" with STR(s) can be written as "%s" with s.
+//
+//   - The output doesn't depend on the locale; the decimal point
+//     is always '.'.
+//
+// =============================================================================
+enum FmtArgTag: U8 {
+    FMT_ARG_INT,
+    FMT_ARG_UINT,
+    FMT_ARG_CHAR,
+    FMT_ARG_FLOAT,
+    FMT_ARG_CSTR,
+    FMT_ARG_STR,
+    FMT_ARG_PTR,
+};
+
+struct FmtArg {
+    FmtArgTag tag;
+    U8 size; // Of the original integer type.
+
+    union {
+        I64 i;
+        U64 u;
+        F64 f;
+        CString s;
+        String str;
+        Void *p;
+    };
+};
+
+Void astr_push_fmt_args (AString *, CString fmt, FmtArg *args, U64 arg_count);
+
+template <typename T>
+consteval FmtArgTag fmt_arg_tag () {
+    using U = std::remove_cv_t<T>;
+    if constexpr (std::is_same_v<U, Char>)                                      return FMT_ARG_CHAR;
+    else if constexpr (std::is_same_v<U, Bool>)                                 return FMT_ARG_UINT;
+    else if constexpr (std::is_enum_v<U>)                                       return fmt_arg_tag<std::underlying_type_t<U>>();
+    else if constexpr (std::is_integral_v<U>)                                   return std::is_signed_v<U> ? FMT_ARG_INT : FMT_ARG_UINT;
+    else if constexpr (std::is_floating_point_v<U>)                             return FMT_ARG_FLOAT;
+    else if constexpr (std::is_same_v<U, String>)                               return FMT_ARG_STR;
+    else if constexpr (std::is_same_v<U, Char*> || std::is_same_v<U, CString>) return FMT_ARG_CSTR;
+    else if constexpr (std::is_pointer_v<U> || std::is_null_pointer_v<U>)       return FMT_ARG_PTR;
+    else static_assert(sizeof(T) == 0, "Type can't be formatted.");
+}
+
+template <typename T>
+FmtArg fmt_arg (T v) {
+    FmtArg a;
+    a.tag  = fmt_arg_tag<T>();
+    a.size = sizeof(T);
+    if constexpr (fmt_arg_tag<T>() == FMT_ARG_INT || fmt_arg_tag<T>() == FMT_ARG_CHAR) a.i = static_cast<I64>(v);
+    else if constexpr (fmt_arg_tag<T>() == FMT_ARG_UINT)  a.u = static_cast<U64>(v);
+    else if constexpr (fmt_arg_tag<T>() == FMT_ARG_FLOAT) a.f = static_cast<F64>(v);
+    else if constexpr (fmt_arg_tag<T>() == FMT_ARG_CSTR)  a.s = v;
+    else if constexpr (fmt_arg_tag<T>() == FMT_ARG_STR)   a.str = v;
+    else                                                 a.p = (Void*)(v);
+    return a;
+}
+
+// Returns 0 if the format string can be used with arguments
+// of the given types, otherwise a description of the problem.
+constexpr CString fmt_check (CString fmt, const FmtArgTag *tags, U64 count) {
+    U64 arg = 0;
+    Auto take_int = [&]{
+        if (arg == count || tags[arg] > FMT_ARG_CHAR) return false;
+        arg++;
+        return true;
+    };
+
+    for (CString p = fmt; *p; ++p) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '0' || *p == '#') p++;
+        if (*p == '*') { if (! take_int()) return "Width '*' needs an integer argument."; p++; }
+        else while (*p >= '0' && *p <= '9') p++;
+
+        if (*p == '.') {
+            p++;
+            if (*p == '*') { if (! take_int()) return "Precision '*' needs an integer argument."; p++; }
+            else while (*p >= '0' && *p <= '9') p++;
+        }
+
+        while (*p == 'h' || *p == 'l' || *p == 'L' || *p == 'q' || *p == 'j' || *p == 'z' || *p == 't') p++;
+        if (arg == count) return "Too few arguments.";
+        FmtArgTag tag = tags[arg++];
+
+        switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if (tag > FMT_ARG_CHAR) return "Integer conversion with a non integer argument.";
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            if (tag != FMT_ARG_FLOAT) return "Float conversion with a non float argument.";
+            break;
+        case 's':
+            if (tag != FMT_ARG_CSTR && tag != FMT_ARG_STR) return "String conversion with a non string argument.";
+            break;
+        case 'p':
+            if (tag != FMT_ARG_PTR && tag != FMT_ARG_CSTR) return "Pointer conversion with a non pointer argument.";
+            break;
+        default:
+            return "Unknown conversion.";
+        }
+    }
+
+    return (arg == count) ? 0 : "Too many arguments.";
+}
+
+// Not constexpr, so calling it from a consteval function
+// is a compile error that shows the message.
+Void fmt_invalid (CString message);
+
+template <typename... Args>
+struct FmtStr {
+    CString str;
+
+    consteval FmtStr (CString s) : str(s) {
+        constexpr FmtArgTag tags[] = { fmt_arg_tag<Args>()..., FMT_ARG_INT };
+        CString error = fmt_check(s, tags, sizeof...(Args));
+        if (error) fmt_invalid(error);
+    }
+};
+
+template <typename... Args>
+Void astr_push_fmt (AString *astr, FmtStr<std::type_identity_t<Args>...> fmt, Args... args) {
+    FmtArg fmt_args[] = { fmt_arg(args)..., FmtArg{} };
+    astr_push_fmt_args(astr, fmt.str, fmt_args, sizeof...(Args));
+}
+
+template <typename... Args>
+String astr_fmt (Mem *mem, FmtStr<std::type_identity_t<Args>...> fmt, Args... args) {
+    AString astr = astr_new(mem);
+    astr_push_fmt(&astr, fmt, args...);
+    return astr_to_str(&astr);
+}
+
+// =============================================================================
+// FuzzySession:
+// -------------
+//
+// Fuzzy filtering of a fixed set of haystacks as the user types
+// the query one keystroke at a time.
+//
+// The session keeps a stack of levels. Each level holds the
+// haystacks that matched some prefix of the query, their scores
+// and the offset where the forward search of the match ended:
+//
+//   - When the query grows, only the survivors of the top level
+//     are checked, and the forward search for the new bytes picks
+//     up at the cached offset. The result is pushed as a new level.
+//
+//   - When the query shrinks (backspace) or changes, the levels
+//     that don't belong to a prefix of the new query are popped,
+//     so going back to an earlier query costs no matching at all.
+//
+// Thus the work per keystroke is proportional to the number of
+// results of the previous query rather than to the corpus.
+//
+// If the search runs on a worker thread, other threads can call
+// fuzzy_session_cancel() when a newer query arrives. The running
+// fuzzy_session_update() then returns false without a result and
+// drops the level it was building; the session stays usable.
+//
+// The haystacks, masks and Mem must outlive the session. The Mem
+// must support freeing since levels get popped all the time.
+//
+// Usage example:
+// --------------
+//
+//     Auto session = fuzzy_session_new(mem, slice(&todos), slice(&masks));
+//     Array<FuzzyMatch> results = array_new<FuzzyMatch>(mem);
+//
+//     fuzzy_session_update(&session, str("w"), 50, &results);
+//     fuzzy_session_update(&session, str("wo"), 50, &results); // Refines "w".
+//     fuzzy_session_update(&session, str("w"), 50, &results);  // Pops back to "w".
+//
+// =============================================================================
+struct FuzzyLevel {
+    U64 query_count;           // Length of the query prefix.
+    Array<FuzzyMatch> matches; // In haystack order.
+    Array<U64> ends;           // One past the forward match in each haystack.
+};
+
+struct FuzzySession {
+    Mem *mem;
+    Slice<String> haystacks;
+    Slice<U64> masks;          // Optional as in str_fuzzy_top_k().
+    AString query;             // Query of the top level.
+    Array<FuzzyLevel> levels;
+    U64 generation;            // Bumped by fuzzy_session_cancel().
+};
+
+// How many candidates get checked between looks at the generation.
+const U64 FUZZY_CANCEL_CHECK_INTERVAL = 1024;
+
+FuzzySession fuzzy_session_new    (Mem *, Slice<String> haystacks, Slice<U64> masks);
+Void         fuzzy_session_free   (FuzzySession *);
+Void         fuzzy_session_cancel (FuzzySession *);
+Bool         fuzzy_session_update (FuzzySession *, String query, U64 k, Array<FuzzyMatch> *out);
@@ -0,0 +1,280 @@
+#include "base/text_buffer.h"
+
+static U64 count_newlines (String s) {
+    U64 n = 0;
+    for (U64 i = 0; i < s.count; ++i) n += (s.data[i] == '\n');
+    return n;
+}
+
+static U64 next_priority (TextBuffer *buf) {
+    buf->rng ^= buf->rng << 13;
+    buf->rng ^= buf->rng >> 7;
+    buf->rng ^= buf->rng << 17;
+    return buf->rng;
+}
+
+static U64 node_size  (TextNode *n) { return n ? n->size : 0; }
+static U64 node_lines (TextNode *n) { return n ? n->lines : 0; }
+
+static TextNode *node_update (TextNode *n) {
+    n->size  = node_size(n->left) + n->piece.count + node_size(n->right);
+    n->lines = node_lines(n->left) + n->piece_lines + node_lines(n->right);
+    return n;
+}
+
+static TextNode *node_copy (TextBuffer *buf, TextNode *n) {
+    TextNode *r = mem_new(buf->mem, TextNode);
+    *r = *n;
+    return r;
+}
+
+static TextNode *node_new (TextBuffer *buf, String piece, U64 piece_lines) {
+    TextNode *n    = mem_new(buf->mem, TextNode);
+    n->piece       = piece;
+    n->piece_lines = piece_lines;
+    n->priority    = next_priority(buf);
+    return node_update(n);
+}
+
+// Persistent merge: all nodes in a precede all nodes in b.
+static TextNode *merge (TextBuffer *buf, TextNode *a, TextNode *b) {
+    if (! a) return b;
+    if (! b) return a;
+
+    if (a->priority > b->priority) {
+        TextNode *r = node_copy(buf, a);
+        r->right = merge(buf, a->right, b);
+        return node_update(r);
+    } else {
+        TextNode *r = node_copy(buf, b);
+        r->left = merge(buf, a, b->left);
+        return node_update(r);
+    }
+}
+
+// Persistent split into the first offset bytes and the rest.
+// A piece straddling the offset is split in two.
+static Void split (TextBuffer *buf, TextNode *n, U64 offset, TextNode **out_l, TextNode **out_r) {
+    if (! n) { *out_l = 0; *out_r = 0; return; }
+
+    U64 left_size = node_size(n->left);
+    U64 piece_end = left_size + n->piece.count;
+
+    if (offset <= left_size) {
+        TextNode *r = node_copy(buf, n);
+        split(buf, n->left, offset, out_l, &r->left);
+        *out_r = node_update(r);
+    } else if (offset >= piece_end) {
+        TextNode *l = node_copy(buf, n);
+        split(buf, n->right, offset - piece_end, &l->right, out_r);
+        *out_l = node_update(l);
+    } else {
+        // Both halves keep the priority of the node, so the
+        // heap order with respect to the subtrees still holds.
+        U64 cut = offset - left_size;
+        TextNode *l = node_copy(buf, n);
+        TextNode *r = node_copy(buf, n);
+
+        l->piece       = str_prefix_to(n->piece, cut);
+        l->piece_lines = count_newlines(l->piece);
+        l->right       = 0;
+        r->piece       = str_suffix_from(n->piece, cut);
+        r->piece_lines = n->piece_lines - l->piece_lines;
+        r->left        = 0;
+
+        *out_l = node_update(l);
+        *out_r = node_update(r);
+    }
+}
+
+// Copies text into the add buffer and returns the copy. Texts
+// that don't fit into a chunk get an allocation of their own.
+static String add_text (TextBuffer *buf, String text) {
+    if (text.count >= TEXT_ADD_CHUNK) {
+        Char *p = mem_alloc(buf->mem, Char, .size=text.count, .align=1);
+        memcpy(p, text.data, text.count);
+        return { p, text.count };
+    }
+
+    if (text.count > TEXT_ADD_CHUNK - buf->add_used) {
+        buf->add_chunk = mem_alloc(buf->mem, Char, .size=TEXT_ADD_CHUNK, .align=1);
+        buf->add_used  = 0;
+    }
+
+    String r = { buf->add_chunk + buf->add_used, text.count };
+    memcpy(r.data, text.data, text.count);
+    buf->add_used += text.count;
+    return r;
+}
+
+// Builds a tree out of text cut into pieces of at most
+// TEXT_PIECE_MAX bytes.
+static TextNode *build (TextBuffer *buf, String text) {
+    TextNode *root = 0;
+
+    for (U64 i = 0; i < text.count; i += TEXT_PIECE_MAX) {
+        String piece = str_slice(text, i, min(TEXT_PIECE_MAX, text.count - i));
+        root = merge(buf, root, node_new(buf, piece, count_newlines(piece)));
+    }
+
+    return root;
+}
+
+Void text_buffer_init (TextBuffer *buf, Mem *mem, String text) {
+    *buf = { .mem=mem, .add_used=TEXT_ADD_CHUNK, .rng=0x9e3779b97f4a7c15 };
+    buf->root = build(buf, text);
+}
+
+TextBuffer text_buffer_new (Mem *mem, String text) {
+    TextBuffer buf;
+    text_buffer_init(&buf, mem, text);
+    return buf;
+}
+
+U64 text_buffer_size (TextBuffer *buf) {
+    return node_size(buf->root);
+}
+
+U64 text_buffer_line_count (TextBuffer *buf) {
+    return node_lines(buf->root) + 1;
+}
+
+Void text_buffer_insert (TextBuffer *buf, U64 offset, String text) {
+    assert_always(offset <= text_buffer_size(buf));
+    if (text.count == 0) return;
+
+    TextNode *l, *r;
+    split(buf, buf->root, offset, &l, &r);
+    buf->root = merge(buf, merge(buf, l, build(buf, add_text(buf, text))), r);
+}
+
+Void text_buffer_delete (TextBuffer *buf, U64 offset, U64 count) {
+    assert_always(offset + count <= text_buffer_size(buf));
+    if (count == 0) return;
+
+    TextNode *l, *m, *r;
+    split(buf, buf->root, offset, &l, &r);
+    split(buf, r, count, &m, &r);
+    buf->root = merge(buf, l, r);
+}
+
+TextSnapshot text_buffer_snapshot (TextBuffer *buf) {
+    return buf->root;
+}
+
+Void text_buffer_restore (TextBuffer *buf, TextSnapshot snapshot) {
+    buf->root = snapshot;
+}
+
+// Returns the offset of the first byte of the line. If the
+// line is past the last one, the size of the text is returned.
+U64 text_buffer_line_offset (TextBuffer *buf, U64 line) {
+    if (line == 0) return 0;
+    if (line > node_lines(buf->root)) return text_buffer_size(buf);
+
+    // Find the byte after the line-th newline.
+    TextNode *n = buf->root;
+    U64 offset  = 0;
+
+    while (true) {
+        U64 left_lines = node_lines(n->left);
+
+        if (line <= left_lines) {
+            n = n->left;
+        } else if (line <= left_lines + n->piece_lines) {
+            line   -= left_lines;
+            offset += node_size(n->left);
+            array_iter (c, &n->piece) if (c == '\n' && --line == 0) return offset + ARRAY_IDX + 1;
+            badpath;
+        } else {
+            line   -= left_lines + n->piece_lines;
+            offset += node_size(n->left) + n->piece.count;
+            n = n->right;
+        }
+    }
+}
+
+U64 text_buffer_offset_to_line (TextBuffer *buf, U64 offset) {
+    assert_always(offset <= text_buffer_size(buf));
+    TextNode *n = buf->root;
+    U64 line    = 0;
+
+    while (n) {
+        U64 left_size = node_size(n->left);
+
+        if (offset < left_size) {
+            n = n->left;
+        } else if (offset < left_size + n->piece.count) {
+            return line + node_lines(n->left) + count_newlines(str_prefix_to(n->piece, offset - left_size));
+        } else {
+            line   += node_lines(n->left) + n->piece_lines;
+            offset -= left_size + n->piece.count;
+            n = n->right;
+        }
+    }
+
+    return line;
+}
+
+Char text_buffer_get_byte (TextBuffer *buf, U64 offset) {
+    assert_always(offset < text_buffer_size(buf));
+    TextNode *n = buf->root;
+
+    while (true) {
+        U64 left_size = node_size(n->left);
+
+        if (offset < left_size) {
+            n = n->left;
+        } else if (offset < left_size + n->piece.count) {
+            return n->piece.data[offset - left_size];
+        } else {
+            offset -= left_size + n->piece.count;
+            n = n->right;
+        }
+    }
+}
+
+static Void push_slices (TextNode *n, U64 offset, U64 count, Array<String> *out) {
+    if (!n || count == 0) return;
+
+    U64 left_size = node_size(n->left);
+
+    if (offset < left_size) push_slices(n->left, offset, count, out);
+
+    U64 from = (offset > left_size) ? offset - left_size : 0;
+    U64 to   = min(offset + count - left_size, n->piece.count);
+    if (offset + count > left_size && from < n->piece.count) array_push(out, str_slice(n->piece, from, to - from));
+
+    U64 piece_end = left_size + n->piece.count;
+    if (offset + count > piece_end) {
+        U64 skip = (offset > piece_end) ? offset - piece_end : 0;
+        push_slices(n->right, skip, offset + count - piece_end - skip, out);
+    }
+}
+
+// Pushes slices that together form the given byte range.
+// No bytes are copied.
+Void text_buffer_slices (TextBuffer *buf, U64 offset, U64 count, Array<String> *out) {
+    assert_always(offset + count <= text_buffer_size(buf));
+    push_slices(buf->root, offset, count, out);
+}
+
+// Pushes the slices of the line without its newline.
+Void text_buffer_line (TextBuffer *buf, U64 line, Array<String> *out) {
+    U64 start = text_buffer_line_offset(buf, line);
+    U64 end   = text_buffer_line_offset(buf, line + 1);
+    if (end > start && line < node_lines(buf->root)) end--;
+    text_buffer_slices(buf, start, end - start, out);
+}
+
+static Void push_to_astr (TextNode *n, AString *astr) {
+    if (! n) return;
+    push_to_astr(n->left, astr);
+    astr_push_str(astr, n->piece);
+    push_to_astr(n->right, astr);
+}
+
+Void text_buffer_push_to_astr (TextBuffer *buf, AString *astr) {
+    array_ensure_capacity_min(astr, text_buffer_size(buf));
+    push_to_astr(buf->root, astr);
+}
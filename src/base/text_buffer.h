@@ -0,0 +1,81 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// A piece table for editing large texts.
+//
+// The text is a sequence of pieces, each a String pointing either
+// into the original text or into an append-only add buffer that
+// receives all inserted bytes. The pieces are kept in a treap
+// ordered by position where every node also stores the byte and
+// newline count of its subtree, so insert, delete and line lookup
+// are all O(log n) in the number of pieces.
+//
+// The tree is persistent: edits copy the nodes on the path they
+// touch and never mutate existing ones. A snapshot is thus just
+// the root pointer, and restoring one (for undo) is O(1). The
+// price is that old nodes are only reclaimed when the Mem is, so
+// the Mem should be an arena dedicated to the buffer.
+//
+// The original text is not copied and must outlive the buffer.
+//
+// Lines are 0-indexed.
+//
+// Usage example:
+// --------------
+//
+//     Auto buf = text_buffer_new(arena, file_content);
+//     TextSnapshot undo = text_buffer_snapshot(&buf);
+//     text_buffer_insert(&buf, 5, str("foo"));
+//     text_buffer_delete(&buf, 0, 2);
+//
+//     Array<String> slices = array_new<String>(mem);
+//     text_buffer_line(&buf, 1, &slices);
+//     text_buffer_restore(&buf, undo);
+//
+// =============================================================================
+#include "base/string.h"
+
+// Max bytes per piece. Splitting a piece has to count the
+// newlines in one half, so this bounds the cost of an edit.
+const U64 TEXT_PIECE_MAX = 16*KB;
+
+// Size of the chunks of the add buffer.
+const U64 TEXT_ADD_CHUNK = 64*KB;
+
+struct TextNode {
+    TextNode *left;
+    TextNode *right;
+    String piece;
+    U64 piece_lines; // Newlines in piece.
+    U64 size;        // Bytes in subtree.
+    U64 lines;       // Newlines in subtree.
+    U64 priority;
+};
+
+typedef TextNode *TextSnapshot;
+
+struct TextBuffer {
+    Mem *mem;
+    TextNode *root;
+    Char *add_chunk;
+    U64 add_used;
+    U64 rng;
+};
+
+Void         text_buffer_init           (TextBuffer *, Mem *, String text);
+TextBuffer   text_buffer_new            (Mem *, String text);
+U64          text_buffer_size           (TextBuffer *);
+U64          text_buffer_line_count     (TextBuffer *);
+Void         text_buffer_insert         (TextBuffer *, U64 offset, String text);
+Void         text_buffer_delete         (TextBuffer *, U64 offset, U64 count);
+TextSnapshot text_buffer_snapshot       (TextBuffer *);
+Void         text_buffer_restore        (TextBuffer *, TextSnapshot);
+U64          text_buffer_line_offset    (TextBuffer *, U64 line);
+U64          text_buffer_offset_to_line (TextBuffer *, U64 offset);
+Char         text_buffer_get_byte       (TextBuffer *, U64 offset);
+Void         text_buffer_slices         (TextBuffer *, U64 offset, U64 count, Array<String> *out);
+Void         text_buffer_line           (TextBuffer *, U64 line, Array<String> *out);
+Void         text_buffer_push_to_astr   (TextBuffer *, AString *);
@@ -0,0 +1,62 @@
+#pragma once
+
+// =============================================================================
+// Overview:
+// ---------
+//
+// Helpers shared by the benchmark drivers in this directory.
+//
+// Each driver is a standalone program with its own main(). The
+// "bench" make target builds every one of them in release mode
+// against the rest of the tree (minus main.cpp and the GTK code)
+// and runs them. The drivers are not part of the app build.
+//
+// A benchmark reports the fastest of several runs since that is
+// the most stable number on a busy machine. Results that would
+// otherwise be unused go through bench_keep() so that the
+// compiler can't drop the work.
+//
+// Usage example:
+// --------------
+//
+//     F64 ns = bench_min_ns([&]{ bench_keep(str_hash(s)); });
+//     printf("%.1f ns\n", ns);
+//
+// =============================================================================
+#include <stdio.h>
+#include "base/mem.h"
+#include "os/time.h"
+
+const U64 BENCH_RUNS = 7;
+
+inline volatile U64 bench_sink;
+
+inline Void bench_keep (U64 v) { bench_sink = v; }
+
+template <typename F>
+F64 bench_min_ns (const F &fn, U64 runs=BENCH_RUNS) {
+    U64 best = UINT64_MAX;
+
+    for (U64 i = 0; i < runs; ++i) {
+        U64 start = os_time_ns();
+        fn();
+        best = min(best, os_time_ns() - start);
+    }
+
+    return static_cast<F64>(best);
+}
+
+// Bytes per nanosecond is GB/s.
+inline F64 bench_gbps (U64 bytes, F64 ns) { return static_cast<F64>(bytes) / ns; }
+
+inline Void bench_setup () {
+    tmem_setup(&mem_root, 64*MB);
+}
+
+// xorshift64 so that the inputs are the same on every run.
+inline U64 bench_random (U64 *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
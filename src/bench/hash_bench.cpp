@@ -0,0 +1,112 @@
+// Compares str_hash (wyhash) and the integer hash() overloads with
+// the byte-wise FNV-1a they replaced: collisions on realistic keys
+// and throughput at several input sizes.
+#include <math.h>
+#include "bench/bench.h"
+#include "base/string.h"
+
+static U64 fnv1a (String str) {
+    U64 h = 0xcbf29ce484222325;
+    array_iter (b, &str) h = (h ^ static_cast<U64>(b)) * 0x01000193;
+    return h;
+}
+
+static U64 fnv1a_u64 (U64 n) {
+    return fnv1a(String{ .data=reinterpret_cast<Char*>(&n), .count=8 });
+}
+
+const U64 KEY_COUNT    = 200000;
+const U64 BUCKET_BITS  = 18; // Map capacity for KEY_COUNT at < 80% load.
+
+// Reports full 64 bit collisions and collisions in the low bits
+// that Map uses as the slot index. For a good hash the latter is
+// close to what uniform random values give.
+static Void report_collisions (CString name, U64 *hashes, U64 count) {
+    tmem_new(tm);
+    U64 buckets = 1ull << BUCKET_BITS;
+    U8 *seen    = mem_alloc(tm, U8, .zeroed=true, .size=buckets);
+    U64 slot_collisions = 0;
+    for (U64 i = 0; i < count; ++i) slot_collisions += seen[hashes[i] & (buckets - 1)]++ > 0;
+
+    U64 *sorted = mem_alloc(tm, U64, .size=(count * sizeof(U64)), .align=alignof(U64));
+    memcpy(sorted, hashes, count * sizeof(U64));
+    sort_pdq(sorted, count, [](U64 *a, U64 *b){ return c_compare(a, b); });
+    U64 full_collisions = 0;
+    for (U64 i = 1; i < count; ++i) full_collisions += (sorted[i] == sorted[i - 1]);
+
+    F64 expected = count - buckets * (1 - pow(1 - 1.0 / buckets, count));
+    printf("    %-24s 64 bit: %4lu    slot: %6lu (uniform %.0f)\n", name, full_collisions, slot_collisions, expected);
+}
+
+template <typename F>
+static Void collisions_for_keys (CString name, Slice<String> keys, const F &hash_fn) {
+    tmem_new(tm);
+    U64 *hashes = mem_alloc(tm, U64, .size=(keys.count * sizeof(U64)), .align=alignof(U64));
+    for (U64 i = 0; i < keys.count; ++i) hashes[i] = hash_fn(keys.data[i]);
+    report_collisions(name, hashes, keys.count);
+}
+
+template <typename F>
+static Void collisions_for_ints (CString name, const F &hash_fn) {
+    tmem_new(tm);
+    U64 *hashes = mem_alloc(tm, U64, .size=(KEY_COUNT * sizeof(U64)), .align=alignof(U64));
+    for (U64 i = 0; i < KEY_COUNT; ++i) hashes[i] = hash_fn(i << 12); // Like aligned pointers.
+    report_collisions(name, hashes, KEY_COUNT);
+}
+
+// Hashes inputs of the given size at varying offsets into the
+// first half of the buffer so that consecutive calls are
+// independent. Sizes are at most half the buffer.
+template <typename F>
+static F64 throughput (String buf, U64 size, const F &hash_fn) {
+    U64 calls = max(1lu, (64*MB) / max(size, 64lu));
+    U64 mask  = buf.count / 2 - 1;
+
+    F64 ns = bench_min_ns([&]{
+        U64 acc = 0;
+        for (U64 i = 0; i < calls; ++i) acc += hash_fn(String{ buf.data + ((i * 4099) & mask), size });
+        bench_keep(acc);
+    });
+
+    return bench_gbps(calls * size, ns);
+}
+
+Int main () {
+    bench_setup();
+    tmem_new(tm);
+
+    printf("Collisions over %lu keys:\n", KEY_COUNT);
+
+    Array<String> log_keys  = array_new_cap<String>(tm, KEY_COUNT);
+    Array<String> path_keys = array_new_cap<String>(tm, KEY_COUNT);
+    for (U64 i = 0; i < KEY_COUNT; ++i) array_push(&log_keys, astr_fmt(tm, "entry_%lu", i));
+    for (U64 i = 0; i < KEY_COUNT; ++i) array_push(&path_keys, astr_fmt(tm, "/home/user/notes/%03lu/%lu.md", i % 997, i));
+
+    collisions_for_keys("fnv1a   entry_%lu", slice(&log_keys), fnv1a);
+    collisions_for_keys("wyhash  entry_%lu", slice(&log_keys), str_hash);
+    collisions_for_keys("fnv1a   paths", slice(&path_keys), fnv1a);
+    collisions_for_keys("wyhash  paths", slice(&path_keys), str_hash);
+    collisions_for_ints("fnv1a   u64 i<<12", fnv1a_u64);
+    collisions_for_ints("hash()  u64 i<<12", [](U64 n){ return hash(n); });
+
+    printf("\nThroughput (GB/s):\n");
+    printf("    %-8s %10s %10s\n", "size", "fnv1a", "wyhash");
+
+    String buf = { mem_alloc(tm, Char, .size=(2*MB)), 2*MB };
+    U64 rng = 1;
+    for (U64 i = 0; i < buf.count; ++i) buf.data[i] = static_cast<Char>(bench_random(&rng));
+
+    U64 sizes[] = { 8, 64, 1*MB };
+
+    for (U64 size : sizes) {
+        F64 old_gbps = throughput(buf, size, fnv1a);
+        F64 new_gbps = throughput(buf, size, str_hash);
+        printf("    %-8lu %10.2f %10.2f\n", size, old_gbps, new_gbps);
+    }
+
+    U64 n = 1 << 24;
+    F64 old_ns = bench_min_ns([&]{ U64 acc = 0; for (U64 i = 0; i < n; ++i) acc += fnv1a_u64(i); bench_keep(acc); });
+    F64 new_ns = bench_min_ns([&]{ U64 acc = 0; for (U64 i = 0; i < n; ++i) acc += hash(i); bench_keep(acc); });
+    printf("\nhash(U64): fnv1a %.2f ns, hash_mix %.2f ns\n", old_ns / n, new_ns / n);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Sorts 1M timestamp keyed entries with the old array_sort path
+// (std::qsort calling c_compare through a function pointer), with
+// sort_pdq and with sort_radix.
+#include <stdlib.h>
+#include "bench/bench.h"
+#include "base/array.h"
+
+struct Entry {
+    U64 timestamp;
+    U64 id;
+    U64 flags;
+};
+
+const U64 ENTRY_COUNT = 1000000;
+
+static Int entry_compare (Entry *a, Entry *b) {
+    return c_compare(&a->timestamp, &b->timestamp);
+}
+
+// This is what array_sort_cmp used to do.
+static Void sort_qsort (Entry *data, U64 count) {
+    Auto fn = reinterpret_cast<int(*)(const Void *, const Void *)>(entry_compare);
+    std::qsort(data, count, sizeof(Entry), fn);
+}
+
+static Void sort_pdq_entries (Entry *data, U64 count) {
+    sort_pdq(data, count, [](Entry *a, Entry *b){ return c_compare(&a->timestamp, &b->timestamp); });
+}
+
+static Void sort_radix_entries (Entry *data, U64 count) {
+    sort_radix(data, count, [](Entry *e){ return radix_key(e->timestamp); });
+}
+
+static Bool is_sorted (Entry *data, U64 count) {
+    for (U64 i = 1; i < count; ++i) if (data[i - 1].timestamp > data[i].timestamp) return false;
+    return true;
+}
+
+// Every run sorts a fresh copy of the input.
+static F64 bench_sort (Entry *input, Entry *work, Void (*sort_fn)(Entry *, U64)) {
+    F64 ns = bench_min_ns([&]{
+        memcpy(work, input, ENTRY_COUNT * sizeof(Entry));
+        sort_fn(work, ENTRY_COUNT);
+    }, 5);
+
+    assert_always(is_sorted(work, ENTRY_COUNT));
+    F64 copy_ns = bench_min_ns([&]{ memcpy(work, input, ENTRY_COUNT * sizeof(Entry)); bench_keep(work[0].id); }, 5);
+    return (ns - copy_ns) / 1e6;
+}
+
+Int main () {
+    bench_setup();
+
+    Entry *input = mem_alloc(&mem_root, Entry, .size=(ENTRY_COUNT * sizeof(Entry)), .align=alignof(Entry));
+    Entry *work  = mem_alloc(&mem_root, Entry, .size=(ENTRY_COUNT * sizeof(Entry)), .align=alignof(Entry));
+    U64 rng      = 1;
+    U64 start    = 1700000000000; // Milliseconds since the epoch.
+
+    printf("Sorting %lu entries of %lu bytes by timestamp (ms):\n", ENTRY_COUNT, sizeof(Entry));
+    printf("    %-14s %10s %10s %10s\n", "input", "qsort", "sort_pdq", "sort_radix");
+
+    CString inputs[] = { "random", "mostly sorted", "reversed" };
+
+    for (U64 kind = 0; kind < 3; ++kind) {
+        for (U64 i = 0; i < ENTRY_COUNT; ++i) {
+            U64 ts = start + i * 1000;
+            if (kind == 0) ts = start + bench_random(&rng) % (ENTRY_COUNT * 1000);
+            if (kind == 1) ts += bench_random(&rng) % 5000; // Log lines arriving slightly out of order.
+            if (kind == 2) ts = start + (ENTRY_COUNT - i) * 1000;
+            input[i] = { ts, i, 0 };
+        }
+
+        F64 q = bench_sort(input, work, sort_qsort);
+        F64 p = bench_sort(input, work, sort_pdq_entries);
+        F64 r = bench_sort(input, work, sort_radix_entries);
+        printf("    %-14s %10.1f %10.1f %10.1f\n", inputs[kind], q, p, r);
+    }
+
+    return 0;
+}
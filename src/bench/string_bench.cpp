@@ -0,0 +1,126 @@
+// Byte search and compare on Strings: the SSE2 and AVX2 kernels
+// behind str_index_of_first/last/any and str_match against the
+// scalar loops they replaced.
+#include <string.h>
+#include "bench/bench.h"
+#include "base/string.h"
+
+// This is what str_index_of_first used to do.
+static U64 scalar_index_of_first (String str, U8 byte) {
+    array_iter (c, &str) if (static_cast<U8>(c) == byte) return ARRAY_IDX;
+    return ARRAY_NIL_IDX;
+}
+
+// This is what str_index_of_last used to do.
+static U64 scalar_index_of_last (String str, U8 byte) {
+    array_iter_back (c, &str) if (static_cast<U8>(c) == byte) return ARRAY_IDX;
+    return ARRAY_NIL_IDX;
+}
+
+// There was no str_index_of_any; this is the loop callers wrote.
+static U64 scalar_index_of_any (String str, String bytes) {
+    array_iter (c, &str) if (memchr(bytes.data, c, bytes.count)) return ARRAY_IDX;
+    return ARRAY_NIL_IDX;
+}
+
+// This is what str_match used to do.
+static Bool scalar_match (String a, String b) {
+    return (a.count == b.count) && (! strncmp(a.data, b.data, a.count));
+}
+
+const U64 MAX_SIZE    = 1*MB;
+const U64 BENCH_BYTES = 64*MB; // Bytes scanned per timed run.
+
+// Text without the bytes that the benchmarks search for.
+static Void fill_text (String buf) {
+    CString words[] = { "lorem", "ipsum", "dolor", "amet", "consectetur", "adipiscing", "elit", "sed", "tempor" };
+    U64 rng = 1;
+    U64 i   = 0;
+
+    while (i < buf.count) {
+        CString w = words[bench_random(&rng) % 9];
+        for (U64 j = 0; w[j] && i < buf.count; ++j) buf.data[i++] = w[j];
+        if (i < buf.count) buf.data[i++] = ' ';
+    }
+}
+
+// The call gets repeated so that every run scans about the same
+// number of bytes. Returns ns per call.
+template <typename F>
+static F64 per_call (U64 size, const F &fn) {
+    U64 calls = max(1lu, BENCH_BYTES / size);
+    F64 ns = bench_min_ns([&]{
+        U64 acc = 0;
+        for (U64 i = 0; i < calls; ++i) acc += fn();
+        bench_keep(acc);
+    });
+    return ns / calls;
+}
+
+enum Impl { IMPL_SCALAR, IMPL_SSE2, IMPL_AVX2, IMPL_COUNT };
+
+template <typename F>
+static Void row (CString name, U64 size, CString hit, const F &fn) {
+    F64 ns[IMPL_COUNT];
+
+    for (U64 impl = 0; impl < IMPL_COUNT; ++impl) {
+        simd_disable_avx2(impl != IMPL_AVX2);
+        if (impl == IMPL_AVX2 && !cpu_has_avx2()) { ns[impl] = 0; continue; }
+        ns[impl] = per_call(size, [&]{ return fn(static_cast<Impl>(impl)); });
+    }
+
+    simd_disable_avx2(false);
+    printf("    %-18s %8lu %-5s %12.1f %12.1f %12.1f\n", name, size, hit, ns[IMPL_SCALAR], ns[IMPL_SSE2], ns[IMPL_AVX2]);
+}
+
+Int main () {
+    bench_setup();
+
+    Char *text  = mem_alloc(&mem_root, Char, .size=MAX_SIZE);
+    Char *copy  = mem_alloc(&mem_root, Char, .size=MAX_SIZE);
+    String seps = str("|\n\t");
+    fill_text({ text, MAX_SIZE });
+    memcpy(copy, text, MAX_SIZE);
+
+    printf("ns per call (AVX2 is 0 if the cpu lacks it):\n");
+    printf("    %-18s %8s %-5s %12s %12s %12s\n", "function", "size", "", "scalar", "sse2", "avx2");
+
+    U64 sizes[] = { 16, 256, MAX_SIZE };
+
+    for (U64 size : sizes) {
+        String s = { text, size };
+
+        // A hit is at the far end of the scan, so it costs
+        // about as much as a miss but takes the other exit.
+        for (U64 hit = 0; hit < 2; ++hit) {
+            CString tag = hit ? "hit" : "miss";
+            if (hit) { text[size - 1] = '|'; text[0] = '|'; }
+
+            row("str_index_of_first", size, tag, [&](Impl impl){
+                String t = hit ? str_suffix_from(s, 1) : s;
+                return (impl == IMPL_SCALAR) ? scalar_index_of_first(t, '|') : str_index_of_first(t, '|');
+            });
+
+            row("str_index_of_last", size, tag, [&](Impl impl){
+                String t = hit ? str_prefix_to(s, size - 1) : s;
+                return (impl == IMPL_SCALAR) ? scalar_index_of_last(t, '|') : str_index_of_last(t, '|');
+            });
+
+            row("str_index_of_any", size, tag, [&](Impl impl){
+                String t = hit ? str_suffix_from(s, 1) : s;
+                return (impl == IMPL_SCALAR) ? scalar_index_of_any(t, seps) : str_index_of_any(t, seps);
+            });
+
+            if (hit) { text[size - 1] = copy[size - 1]; text[0] = copy[0]; }
+        }
+
+        // Equal strings are the slow case since all bytes get compared.
+        row("str_match", size, "equal", [&](Impl impl){
+            String a = s;
+            String b = { copy, size };
+            return static_cast<U64>((impl == IMPL_SCALAR) ? scalar_match(a, b) : str_match(a, b));
+        });
+    }
+
+    return 0;
+}
@@ -33,3 +33,9 @@ Bool    fs_write_entire_file    (String path, String buf);
 // is not counted by String.count. The extra_space is padding
 // at the end of the returned buffer; also not counted.
 String  fs_read_entire_file  (Mem *, String path, U64 extra_space);
+
+// Maps the file read-only into memory. Returns an empty
+// String on failure or if the file is empty. The mapping
+// must be released with fs_unmap_file().
+String  fs_map_file          (String path);
+Void    fs_unmap_file        (String);
@@ -4,6 +4,7 @@
     #include "os/linux/fs.cpp"
     #include "os/linux/time.cpp"
     #include "os/linux/info.cpp"
+    #include "os/linux/thread.cpp"
 #else
     #error "Bad os."
 #endif
@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/sendfile.h>
 #include <stdio.h>
 #include "os/fs.h"
@@ -43,6 +44,26 @@ String fs_read_entire_file (Mem *mem, String path, U64 extra_space) {
     return result;
 }
 
+String fs_map_file (String path) {
+    tmem_new(tm);
+
+    Auto fd = open(cstr(tm, path), O_RDONLY);
+    if (fd < 0) return (String){};
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0)) { close(fd); return (String){}; }
+
+    Void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return (String){};
+
+    return (String){ .data=static_cast<Char*>(p), .count=static_cast<U64>(st.st_size) };
+}
+
+Void fs_unmap_file (String file) {
+    if (file.count) munmap(file.data, file.count);
+}
+
 Bool fs_write_entire_file (String path, String buf) {
     tmem_new(tm);
 
@@ -0,0 +1,31 @@
+#include <pthread.h>
+#include "os/thread.h"
+#include "base/mem.h"
+
+struct ThreadStart {
+    OsThreadFn fn;
+    Void *arg;
+};
+
+static Void *thread_start (Void *ctx) {
+    ThreadStart start = *static_cast<ThreadStart*>(ctx);
+    mem_free(&mem_root, .old_ptr=ctx, .old_size=sizeof(ThreadStart));
+    start.fn(start.arg);
+    return 0;
+}
+
+OsThread os_thread_spawn (OsThreadFn fn, Void *arg) {
+    Auto start = mem_new(&mem_root, ThreadStart);
+    start->fn  = fn;
+    start->arg = arg;
+
+    pthread_t thread;
+    Int err = pthread_create(&thread, 0, thread_start, start);
+    assert_always(! err);
+    return static_cast<OsThread>(thread);
+}
+
+Void os_thread_join (OsThread thread) {
+    Int err = pthread_join(static_cast<pthread_t>(thread), 0);
+    assert_always(! err);
+}
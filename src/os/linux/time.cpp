@@ -11,3 +11,9 @@ U64 os_time_ms () {
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return static_cast<U64>((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
 }
+
+U64 os_time_ns () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<U64>((ts.tv_sec * 1000000000) + ts.tv_nsec);
+}
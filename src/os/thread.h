@@ -0,0 +1,11 @@
+#pragma once
+
+#include "base/core.h"
+
+// Threads spawned with os_thread_spawn() don't have the TMem
+// system set up; call tmem_setup() in the thread fn if needed.
+typedef U64 OsThread;
+typedef Void (*OsThreadFn) (Void *arg);
+
+OsThread os_thread_spawn (OsThreadFn, Void *arg);
+Void     os_thread_join  (OsThread);